@@ -35,6 +35,14 @@
  * code should set the fallback code. But it's possible for arch-specific code
  * to set a preferred form, in which case it will simply be used over the other
  * ones.
+ *
+ * Defining PLOCK_USE_STDATOMIC before including this file disables all the
+ * arch-specific memory operations so that every pl_* operation is built on
+ * the compiler's __atomic builtins with explicit memory orders. These are the
+ * primitives <stdatomic.h> and C++ std::atomic_ref are implemented with, with
+ * the benefit of working on plain integers. The compiler may then optimize
+ * around them (e.g. merge loads or eliminate dead stores), and thread
+ * sanitizers can follow them. Only pl_cpu_relax() remains arch-specific.
  */
 
 /*
@@ -42,9 +50,24 @@
  */
 
 /*
- * ###### ix86 / x86_64 below ######
+ * ###### standard atomics backend below ######
  */
+#if defined(PLOCK_USE_STDATOMIC)
+
 #if defined(__i386__) || defined (__i486__) || defined (__i586__) || defined (__i686__) || defined (__x86_64__)
+#define pl_cpu_relax() do {                   \
+		asm volatile("rep;nop\n");    \
+	} while (0)
+#elif defined(__aarch64__)
+#define pl_cpu_relax() do {				\
+		asm volatile("isb" ::: "memory");	\
+	} while (0)
+#endif
+
+/*
+ * ###### ix86 / x86_64 below ######
+ */
+#elif defined(__i386__) || defined (__i486__) || defined (__i586__) || defined (__i686__) || defined (__x86_64__)
 
 /* for compilers supporting condition flags on output, let's directly return them */
 #if defined(__GCC_ASM_FLAG_OUTPUTS__)
@@ -749,6 +772,80 @@
 	})                                                                    \
 )
 
+/* Double-word operations, on 16-byte objects on x86_64 (cmpxchg16b) and on
+ * 8-byte objects on i586+ (cmpxchg8b), which must be aligned to their size.
+ * <ptr>, <o> and <n> point to objects of the same type, typically a pair of
+ * longs, a pointer and a version, or an unsigned __int128. They are
+ * implemented here because the compiler's __atomic builtins on 16 bytes
+ * usually call libatomic. The double-word load is a compare-and-swap of zero
+ * with zero, and as such requires write access to the object.
+ */
+#if defined(__x86_64__)
+#define __PL_CMPXCHG_DW "lock cmpxchg16b %0\n\t"
+#else
+#define __PL_CMPXCHG_DW "lock cmpxchg8b %0\n\t"
+#endif
+
+/* compare the double word at <ptr> with the one at <o> and replace it with the
+ * one at <n> if they match. Returns non-zero on success, otherwise zero with
+ * the current value stored at <o>.
+ */
+#define pl_cmpxchg_dw(ptr, o, n) (                                            \
+	(sizeof(*(ptr)) == 2 * sizeof(long) &&                                \
+	 sizeof(*(o)) == sizeof(*(ptr)) && sizeof(*(n)) == sizeof(*(ptr))) ? ({ \
+		unsigned char ret;                                            \
+		asm volatile(__PL_CMPXCHG_DW                                  \
+			     X86_COND_Z_TO_REG(1)                             \
+			     : "+m" (*(unsigned long (*)[2])(ptr)),           \
+			       X86_COND_Z_RESULT(ret),                        \
+			       "+a" (((unsigned long *)(o))[0]),              \
+			       "+d" (((unsigned long *)(o))[1])               \
+			     : "b" (((const unsigned long *)(n))[0]),         \
+			       "c" (((const unsigned long *)(n))[1])          \
+			     : "cc", "memory");                               \
+		ret; /* return value */                                       \
+	}) : ({                                                               \
+		void __unsupported_argument_size_for_pl_cmpxchg_dw__(char *,int); \
+		if (sizeof(*(ptr)) != 2 * sizeof(long) ||                     \
+		    sizeof(*(o)) != sizeof(*(ptr)) || sizeof(*(n)) != sizeof(*(ptr))) \
+			__unsupported_argument_size_for_pl_cmpxchg_dw__(__FILE__,__LINE__); \
+		0;                                                            \
+	})                                                                    \
+)
+
+/* atomically load the double word at <ptr> into <dst> */
+#define pl_load_dw(ptr, dst) do {                                             \
+	if (sizeof(*(ptr)) == 2 * sizeof(long) && sizeof(*(dst)) == sizeof(*(ptr))) { \
+		unsigned long __pl_lo = 0, __pl_hi = 0;                       \
+		asm volatile(__PL_CMPXCHG_DW                                  \
+			     : "+m" (*(unsigned long (*)[2])(ptr)),           \
+			       "+a" (__pl_lo), "+d" (__pl_hi)                 \
+			     : "b" (0UL), "c" (0UL)                           \
+			     : "cc", "memory");                               \
+		((unsigned long *)(dst))[0] = __pl_lo;                        \
+		((unsigned long *)(dst))[1] = __pl_hi;                        \
+	} else {                                                              \
+		void __unsupported_argument_size_for_pl_load_dw__(char *,int); \
+		__unsupported_argument_size_for_pl_load_dw__(__FILE__,__LINE__); \
+	}                                                                     \
+} while (0)
+
+/* atomically replace the double word at <ptr> with the one at <n>, and store
+ * the previous one into <dst>.
+ */
+#define pl_xchg_dw(ptr, n, dst) do {                                          \
+	((unsigned long *)(dst))[0] = ((volatile unsigned long *)(ptr))[0];   \
+	((unsigned long *)(dst))[1] = ((volatile unsigned long *)(ptr))[1];   \
+	while (!pl_cmpxchg_dw((ptr), (dst), (n)))                             \
+		;                                                             \
+} while (0)
+
+/* atomically replace the double word at <ptr> with the one at <n> */
+#define pl_store_dw(ptr, n) do {                                              \
+	typeof(*(ptr)) __pl_old;                                              \
+	pl_xchg_dw((ptr), (n), &__pl_old);                                    \
+} while (0)
+
 /*
  * ##### ARM64 (aarch64) below #####
  */
@@ -794,6 +891,30 @@
 #define pl_mb() __atomic_thread_fence(__ATOMIC_SEQ_CST)
 #endif
 
+/* With PLOCK_USE_STDATOMIC, the load/store barriers and the barriers after
+ * atomic operations are fences with the matching memory order, and the bit
+ * test-and-set/reset operations are fetch-and-or/and. Otherwise the arch-
+ * specific versions are preferred since atomic operations may already imply
+ * a full barrier.
+ */
+#if defined(PLOCK_USE_STDATOMIC)
+#define pl_mb_load()      __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define pl_mb_store()     __atomic_thread_fence(__ATOMIC_RELEASE)
+#define pl_mb_ato()       __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define pl_mb_ato_load()  __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define pl_mb_ato_store() __atomic_thread_fence(__ATOMIC_RELEASE)
+
+#define __pl_bit(ptr, bit) (((typeof(*(ptr)))1) << (bit))
+#define pl_btr_lax(ptr, bit) (__atomic_fetch_and((ptr), ~__pl_bit(ptr, bit), __ATOMIC_RELAXED) & __pl_bit(ptr, bit))
+#define pl_btr_acq(ptr, bit) (__atomic_fetch_and((ptr), ~__pl_bit(ptr, bit), __ATOMIC_ACQUIRE) & __pl_bit(ptr, bit))
+#define pl_btr_rel(ptr, bit) (__atomic_fetch_and((ptr), ~__pl_bit(ptr, bit), __ATOMIC_RELEASE) & __pl_bit(ptr, bit))
+#define pl_btr(ptr, bit)     (__atomic_fetch_and((ptr), ~__pl_bit(ptr, bit), __ATOMIC_SEQ_CST) & __pl_bit(ptr, bit))
+#define pl_bts_lax(ptr, bit) (__atomic_fetch_or((ptr), __pl_bit(ptr, bit), __ATOMIC_RELAXED) & __pl_bit(ptr, bit))
+#define pl_bts_acq(ptr, bit) (__atomic_fetch_or((ptr), __pl_bit(ptr, bit), __ATOMIC_ACQUIRE) & __pl_bit(ptr, bit))
+#define pl_bts_rel(ptr, bit) (__atomic_fetch_or((ptr), __pl_bit(ptr, bit), __ATOMIC_RELEASE) & __pl_bit(ptr, bit))
+#define pl_bts(ptr, bit)     (__atomic_fetch_or((ptr), __pl_bit(ptr, bit), __ATOMIC_SEQ_CST) & __pl_bit(ptr, bit))
+#endif
+
 /* atomic load */
 #ifndef pl_load_lax
 #define pl_load_lax(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
@@ -860,7 +981,7 @@
 #endif
 
 #ifndef pl_inc_noret_rel
-#define pl_inc_noret_relc(ptr) ((void)__atomic_add_fetch((ptr), 1, __ATOMIC_RELEASE))
+#define pl_inc_noret_rel(ptr) ((void)__atomic_add_fetch((ptr), 1, __ATOMIC_RELEASE))
 #endif
 
 #ifndef pl_inc_noret
@@ -877,7 +998,7 @@
 #endif
 
 #ifndef pl_dec_noret_rel
-#define pl_dec_noret_relc(ptr) ((void)__atomic_sub_fetch((ptr), 1, __ATOMIC_RELEASE))
+#define pl_dec_noret_rel(ptr) ((void)__atomic_sub_fetch((ptr), 1, __ATOMIC_RELEASE))
 #endif
 
 #ifndef pl_dec_noret
@@ -896,7 +1017,7 @@
 #endif
 
 #ifndef pl_add_rel
-#define pl_add_relc(ptr, x) (__atomic_add_fetch((ptr), (x), __ATOMIC_RELEASE))
+#define pl_add_rel(ptr, x) (__atomic_add_fetch((ptr), (x), __ATOMIC_RELEASE))
 #endif
 
 #ifndef pl_add
@@ -915,7 +1036,7 @@
 #endif
 
 #ifndef pl_sub_rel
-#define pl_sub_relc(ptr, x) (__atomic_sub_fetch((ptr), (x), __ATOMIC_RELEASE))
+#define pl_sub_rel(ptr, x) (__atomic_sub_fetch((ptr), (x), __ATOMIC_RELEASE))
 #endif
 
 #ifndef pl_sub
@@ -934,7 +1055,7 @@
 #endif
 
 #ifndef pl_and_rel
-#define pl_and_relc(ptr, x) (__atomic_and_fetch((ptr), (x), __ATOMIC_RELEASE))
+#define pl_and_rel(ptr, x) (__atomic_and_fetch((ptr), (x), __ATOMIC_RELEASE))
 #endif
 
 #ifndef pl_and
@@ -953,7 +1074,7 @@
 #endif
 
 #ifndef pl_or_rel
-#define pl_or_relc(ptr, x)  (__atomic_or_fetch((ptr), (x), __ATOMIC_RELEASE))
+#define pl_or_rel(ptr, x)  (__atomic_or_fetch((ptr), (x), __ATOMIC_RELEASE))
 #endif
 
 #ifndef pl_or
@@ -972,7 +1093,7 @@
 #endif
 
 #ifndef pl_xor_rel
-#define pl_xor_relc(ptr, x) (__atomic_xor_fetch((ptr), (x), __ATOMIC_RELEASE))
+#define pl_xor_rel(ptr, x) (__atomic_xor_fetch((ptr), (x), __ATOMIC_RELEASE))
 #endif
 
 #ifndef pl_xor
@@ -1005,6 +1126,56 @@
 	__old; })
 #endif
 
+/* double-word operations on pairs of longs, see the x86 section. On 64-bit
+ * platforms other than x86_64, and on aarch64 without LSE (-march=armv8.1-a
+ * or later), the compiler turns these 16-byte builtins into calls to
+ * libatomic, so programs using them must be linked with -latomic.
+ */
+#ifndef pl_cmpxchg_dw
+#define pl_cmpxchg_dw(ptr, o, n) (                                            \
+	(sizeof(*(ptr)) == 2 * sizeof(long)) ?                                \
+		__atomic_compare_exchange((ptr), (o), (n), 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED) : ({ \
+		void __unsupported_argument_size_for_pl_cmpxchg_dw__(char *,int); \
+		if (sizeof(*(ptr)) != 2 * sizeof(long))                       \
+			__unsupported_argument_size_for_pl_cmpxchg_dw__(__FILE__,__LINE__); \
+		0;                                                            \
+	})                                                                    \
+)
+#endif
+
+#ifndef pl_load_dw
+#define pl_load_dw(ptr, dst) do {                                             \
+	if (sizeof(*(ptr)) == 2 * sizeof(long))                               \
+		__atomic_load((ptr), (dst), __ATOMIC_SEQ_CST);                \
+	else {                                                                \
+		void __unsupported_argument_size_for_pl_load_dw__(char *,int); \
+		__unsupported_argument_size_for_pl_load_dw__(__FILE__,__LINE__); \
+	}                                                                     \
+} while (0)
+#endif
+
+#ifndef pl_xchg_dw
+#define pl_xchg_dw(ptr, n, dst) do {                                          \
+	if (sizeof(*(ptr)) == 2 * sizeof(long))                               \
+		__atomic_exchange((ptr), (n), (dst), __ATOMIC_SEQ_CST);       \
+	else {                                                                \
+		void __unsupported_argument_size_for_pl_xchg_dw__(char *,int); \
+		__unsupported_argument_size_for_pl_xchg_dw__(__FILE__,__LINE__); \
+	}                                                                     \
+} while (0)
+#endif
+
+#ifndef pl_store_dw
+#define pl_store_dw(ptr, n) do {                                              \
+	if (sizeof(*(ptr)) == 2 * sizeof(long))                               \
+		__atomic_store((ptr), (n), __ATOMIC_SEQ_CST);                 \
+	else {                                                                \
+		void __unsupported_argument_size_for_pl_store_dw__(char *,int); \
+		__unsupported_argument_size_for_pl_store_dw__(__FILE__,__LINE__); \
+	}                                                                     \
+} while (0)
+#endif
+
 /* fetch-and-add: fetch integer value pointed to by pointer <ptr>, add <x> to
  * to <*ptr> and return the previous value.
  */
@@ -1017,7 +1188,7 @@
 #endif
 
 #ifndef pl_ldadd_rel
-#define pl_ldadd_relc(ptr, x)   (__atomic_fetch_add((ptr), (x), __ATOMIC_RELEASE))
+#define pl_ldadd_rel(ptr, x)   (__atomic_fetch_add((ptr), (x), __ATOMIC_RELEASE))
 #endif
 
 #ifndef pl_ldadd
@@ -1034,7 +1205,7 @@
 #endif
 
 #ifndef pl_ldand_rel
-#define pl_ldand_relc(ptr, x)   (__atomic_fetch_and((ptr), (x), __ATOMIC_RELEASE))
+#define pl_ldand_rel(ptr, x)   (__atomic_fetch_and((ptr), (x), __ATOMIC_RELEASE))
 #endif
 
 #ifndef pl_ldand
@@ -1051,7 +1222,7 @@
 #endif
 
 #ifndef pl_ldor_rel
-#define pl_ldor_relc(ptr, x)    (__atomic_fetch_or((ptr), (x), __ATOMIC_RELEASE))
+#define pl_ldor_rel(ptr, x)    (__atomic_fetch_or((ptr), (x), __ATOMIC_RELEASE))
 #endif
 
 #ifndef pl_ldor
@@ -1068,7 +1239,7 @@
 #endif
 
 #ifndef pl_ldsub_rel
-#define pl_ldsub_relc(ptr, x)   (__atomic_fetch_sub((ptr), (x), __ATOMIC_RELEASE))
+#define pl_ldsub_rel(ptr, x)   (__atomic_fetch_sub((ptr), (x), __ATOMIC_RELEASE))
 #endif
 
 #ifndef pl_ldsub
@@ -1085,7 +1256,7 @@
 #endif
 
 #ifndef pl_ldxor_rel
-#define pl_ldxor_relc(ptr, x)   (__atomic_fetch_xor((ptr), (x), __ATOMIC_RELEASE))
+#define pl_ldxor_rel(ptr, x)   (__atomic_fetch_xor((ptr), (x), __ATOMIC_RELEASE))
 #endif
 
 #ifndef pl_ldxor
@@ -1988,4 +2159,312 @@
 #endif
 
 
+
+/*
+ * Read-compute-CAS loop. pl_update(ptr, var, expr) loads <*ptr> into a new
+ * variable <var> of the same type, evaluates <expr> which may use <var>, and
+ * tries to replace <*ptr> with the result using pl_cmpxchg(). On failure,
+ * <var> takes the value returned by pl_cmpxchg() instead of reloading it, and
+ * the retry is delayed following the same exponential backoff progression as
+ * __pl_wait_unlock_long() in plock.h, so that contending threads spread their
+ * attempts instead of thrashing the cache line. If <expr> evaluates to <var>,
+ * nothing is written, which is cheap for max-updates or saturated counters,
+ * but implies no memory barrier. The macro returns the value that was
+ * replaced, or the unchanged one. <expr> may be evaluated multiple times and
+ * must not have side effects. The backoff is disabled by PLOCK_DISABLE_EBO.
+ */
+#if defined(PLOCK_DISABLE_EBO)
+#define __pl_update_backoff(m) pl_cpu_relax()
+#else
+#define __pl_update_backoff(m) do {                                           \
+	unsigned int __pl_loops = (m);                                        \
+	for (; __pl_loops >= 60; __pl_loops--)                                \
+		pl_cpu_relax();                                               \
+	for (; __pl_loops >= 1; __pl_loops--)                                 \
+		pl_barrier();                                                 \
+	(m) = (((m) + ((m) >> 1)) + 2) & 0x3ffff;                             \
+} while (0)
+#endif
+
+#define pl_update(ptr, var, expr) ({                                          \
+	typeof(*(ptr)) var = pl_load(ptr);                                    \
+	typeof(*(ptr)) __pl_new, __pl_prev;                                   \
+	unsigned int __pl_m = 0;                                              \
+	while (1) {                                                           \
+		__pl_new = (expr);                                            \
+		if (__pl_new == var)                                          \
+			break;                                                \
+		__pl_prev = pl_cmpxchg((ptr), var, __pl_new);                 \
+		if (__builtin_expect(__pl_prev == var, 1))                    \
+			break;                                                \
+		var = __pl_prev;                                              \
+		__pl_update_backoff(__pl_m);                                  \
+	}                                                                     \
+	(void)__pl_m;                                                         \
+	var; /* return value */                                               \
+})
+
+/*
+ * Per-CPU operations, only enabled when PL_USE_PERCPU is defined since they
+ * require system headers. The data are arrays of slots indexed by the CPU
+ * number, of which the caller only passes the base address and the stride in
+ * bytes. On x86_64 Linux with glibc >= 2.35 which registers an rseq area for
+ * each thread, the operations run as restartable sequences: the kernel aborts
+ * the sequence if the thread is preempted or migrated before the final store,
+ * so that no LOCK-prefixed instruction is needed. This may be disabled by
+ * defining PL_PERCPU_NO_RSEQ. Otherwise, or if rseq is not registered, the
+ * slot is chosen by sched_getcpu() and the operation is a regular atomic one,
+ * which remains correct if the thread migrates in the middle since all
+ * threads using this slot also use atomic operations.
+ */
+#if defined(PL_USE_PERCPU)
+
+#include <sched.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__x86_64__) && defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 35)) && !defined(PL_PERCPU_NO_RSEQ)
+#define PL_PERCPU_RSEQ
+#include <sys/rseq.h>
+#elif !defined(__USE_GNU) && defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#define __pl_percpu_str2(x) #x
+#define __pl_percpu_str(x) __pl_percpu_str2(x)
+
+/* one per-CPU free list head, with a lock only used by the fallback */
+struct pl_percpu_list {
+	void *head;
+	unsigned long lock;
+} __attribute__((aligned(64)));
+
+/* list element, to be placed at the beginning of the caller's objects */
+struct pl_percpu_node {
+	struct pl_percpu_node *next;
+};
+
+/* returns the current CPU number using the system, or zero if unknown */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static unsigned int __pl_percpu_getcpu()
+{
+	int cpu;
+
+#if defined(__USE_GNU)
+	cpu = sched_getcpu();
+#elif defined(__linux__) && defined(SYS_getcpu)
+	unsigned int c;
+	cpu = syscall(SYS_getcpu, &c, NULL, NULL) == 0 ? (int)c : -1;
+#else
+	cpu = -1;
+#endif
+	return cpu < 0 ? 0 : cpu;
+}
+
+#if defined(PL_PERCPU_RSEQ)
+
+/* returns the current thread's rseq area, or NULL if rseq is not registered */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static struct rseq *__pl_rseq_area()
+{
+	char *tp;
+
+	if (!__rseq_size)
+		return NULL;
+	asm("movq %%fs:0, %0" : "=r" (tp));
+	return (struct rseq *)(tp + __rseq_offset);
+}
+
+/* Each sequence below declares its rseq_cs descriptor (label 3) in the
+ * __rseq_cs section, installs it in the thread's rseq area, and checks that it
+ * still runs on CPU <cpu> (label 1). The commit is the last instruction before
+ * label 2. Upon preemption, migration or signal delivery, the kernel diverts
+ * execution to the abort handler (label 4), preceded by the signature, which
+ * jumps to the C label. The descriptor doesn't need to be cleared afterwards.
+ */
+#define __PL_RSEQ_START                                                      \
+	".pushsection __rseq_cs, \"aw\"\n"                                   \
+	".balign 32\n"                                                       \
+	"3:\n"                                                               \
+	".long 0x0, 0x0\n"                                                   \
+	".quad 1f, (2f - 1f), 4f\n"                                          \
+	".popsection\n"                                                      \
+	"leaq 3b(%%rip), %%rax\n"                                            \
+	"movq %%rax, %[rseq_cs]\n"                                           \
+	"1:\n"                                                               \
+	"cmpl %[cpu], %[cpu_id]\n"                                           \
+	"jnz 4f\n"
+
+#define __PL_RSEQ_END                                                        \
+	"2:\n"                                                               \
+	".pushsection __rseq_failure, \"ax\"\n"                              \
+	".byte 0x0f, 0xb9, 0x3d\n"                                           \
+	".long " __pl_percpu_str(RSEQ_SIG) "\n"                              \
+	"4:\n"                                                               \
+	"jmp %l[abort]\n"                                                    \
+	".popsection\n"
+
+#define __PL_RSEQ_ARGS(rs, cpu)                                              \
+	[cpu] "r" (cpu), [cpu_id] "m" ((rs)->cpu_id),                        \
+	[rseq_cs] "m" (*(unsigned long long *)&(rs)->rseq_cs)
+
+#endif /* PL_PERCPU_RSEQ */
+
+/* returns the number of the CPU the thread is currently running on. It may
+ * have changed by the time the value is used.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static unsigned int pl_percpu_cpu()
+{
+#if defined(PL_PERCPU_RSEQ)
+	struct rseq *rs = __pl_rseq_area();
+
+	if (rs)
+		return pl_load(&rs->cpu_id_start);
+#endif
+	return __pl_percpu_getcpu();
+}
+
+/* adds <v> to the current CPU's slot among the unsigned longs located every
+ * <stride> bytes starting at <base>.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_percpu_add(unsigned long *base, unsigned long stride, unsigned long v)
+{
+	unsigned long *ptr;
+	unsigned int cpu;
+
+#if defined(PL_PERCPU_RSEQ)
+	struct rseq *rs = __pl_rseq_area();
+
+	while (rs) {
+		cpu = pl_load(&rs->cpu_id_start);
+		ptr = (unsigned long *)((char *)base + cpu * stride);
+		asm goto(__PL_RSEQ_START
+			 "addq %[v], %[ptr]\n"
+			 __PL_RSEQ_END
+			 : : __PL_RSEQ_ARGS(rs, cpu), [ptr] "m" (*ptr), [v] "er" (v)
+			 : "memory", "cc", "rax" : abort);
+		return;
+	abort:
+		;
+	}
+#endif
+	cpu = __pl_percpu_getcpu();
+	ptr = (unsigned long *)((char *)base + cpu * stride);
+	pl_add_noret(ptr, v);
+}
+
+/* replaces the value at <ptr> with <repl> if it still is <old> and if the
+ * thread still runs on CPU <cpu>, which must be the one <ptr> was chosen for
+ * (as returned by pl_percpu_cpu()). Returns non-zero on success, or zero if
+ * the value differs or the thread was preempted or migrated, in which case the
+ * caller must retrieve the CPU and the value again before retrying.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static int pl_percpu_cmpxchg(unsigned long *ptr, unsigned long old, unsigned long repl, unsigned int cpu)
+{
+#if defined(PL_PERCPU_RSEQ)
+	struct rseq *rs = __pl_rseq_area();
+
+	if (rs) {
+		asm goto(__PL_RSEQ_START
+			 "cmpq %[ptr], %[old]\n"
+			 "jnz %l[abort]\n"
+			 "movq %[repl], %[ptr]\n"
+			 __PL_RSEQ_END
+			 : : __PL_RSEQ_ARGS(rs, cpu), [ptr] "m" (*ptr), [old] "r" (old), [repl] "r" (repl)
+			 : "memory", "cc", "rax" : abort);
+		return 1;
+	abort:
+		return 0;
+	}
+#endif
+	(void)cpu;
+	return pl_cmpxchg(ptr, old, repl) == old;
+}
+
+/* pushes node <node> to the current CPU's list among the array <lists>. */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_percpu_push(struct pl_percpu_list *lists, struct pl_percpu_node *node)
+{
+	struct pl_percpu_list *list;
+
+#if defined(PL_PERCPU_RSEQ)
+	struct rseq *rs = __pl_rseq_area();
+	unsigned int cpu;
+
+	while (rs) {
+		cpu = pl_load(&rs->cpu_id_start);
+		list = &lists[cpu];
+		asm goto(__PL_RSEQ_START
+			 "movq %[head], %%rax\n"
+			 "movq %%rax, %[next]\n"
+			 "movq %[node], %[head]\n"
+			 __PL_RSEQ_END
+			 : : __PL_RSEQ_ARGS(rs, cpu), [head] "m" (list->head),
+			     [next] "m" (node->next), [node] "r" (node)
+			 : "memory", "cc", "rax" : abort);
+		return;
+	abort:
+		;
+	}
+#endif
+	list = &lists[__pl_percpu_getcpu()];
+	while (pl_xchg(&list->lock, 1))
+		pl_cpu_relax();
+	node->next = list->head;
+	list->head = node;
+	pl_store(&list->lock, 0);
+}
+
+/* pops a node from the current CPU's list among the array <lists>. Returns
+ * NULL if this list is empty, even if other CPUs' lists are not.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static struct pl_percpu_node *pl_percpu_pop(struct pl_percpu_list *lists)
+{
+	struct pl_percpu_list *list;
+	struct pl_percpu_node *node = NULL;
+
+#if defined(PL_PERCPU_RSEQ)
+	struct rseq *rs = __pl_rseq_area();
+	unsigned int cpu;
+
+	while (rs) {
+		cpu = pl_load(&rs->cpu_id_start);
+		list = &lists[cpu];
+		/* asm goto may not have outputs, so <node> is written through
+		 * its address passed in a register, covered by the memory
+		 * clobber.
+		 */
+		asm goto(__PL_RSEQ_START
+			 "movq %[head], %%rax\n"
+			 "testq %%rax, %%rax\n"
+			 "jz %l[empty]\n"
+			 "movq %%rax, (%[node])\n"
+			 "movq (%%rax), %%rax\n"
+			 "movq %%rax, %[head]\n"
+			 __PL_RSEQ_END
+			 : : __PL_RSEQ_ARGS(rs, cpu), [head] "m" (list->head), [node] "r" (&node)
+			 : "memory", "cc", "rax" : abort, empty);
+		return node;
+	empty:
+		return NULL;
+	abort:
+		;
+	}
+#endif
+	list = &lists[__pl_percpu_getcpu()];
+	while (pl_xchg(&list->lock, 1))
+		pl_cpu_relax();
+	node = list->head;
+	if (node)
+		list->head = node->next;
+	pl_store(&list->lock, 0);
+	return node;
+}
+
+#endif /* PL_USE_PERCPU */
+
 #endif /* PL_ATOMIC_OPS_H */
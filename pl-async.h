@@ -0,0 +1,259 @@
+/* plock - asynchronous lock acquisition
+ *
+ * Copyright (C) 2026 Willy Tarreau <w@1wt.eu>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PL_ASYNC_H
+#define PL_ASYNC_H
+
+/* The functions below allow tasks which cannot get a lock to register a
+ * continuation instead of spinning. A lock is then a struct pl_async_lock,
+ * made of a regular plock word followed by the list of waiting records. The
+ * fast path is the regular one (pl_try_r/s), except for W which fails instead
+ * of waiting for readers to leave (pl_async_try_w). On failure, the caller's
+ * waiter record is pushed to the lock's list, and the waiter bit
+ * PL_ASYNC_WBIT, one of the application bits of the lock, is set. When the
+ * lock is released using pl_drop_{r,s,w}_async(), the releasing thread sees
+ * the waiter bit, detaches the list, takes the lock on behalf of the waiters
+ * that may now get it, and either calls their callback with the lock held,
+ * or appends them to a wake queue passed by the caller, so that the
+ * scheduler can run them later. The other waiters are pushed back.
+ *
+ * The regular pl_take_{r,s,w}() functions may still be used on the lock word,
+ * but all releases must be performed with pl_drop_{r,s,w}_async().
+ */
+
+#include "plock.h"
+
+/* the waiter bit in the lock word */
+#define PL_ASYNC_WBIT  1UL
+
+/* lock types, same as for pl_take_any() */
+#ifndef PL_TAKE_R
+#define PL_TAKE_R  0
+#define PL_TAKE_S  1
+#define PL_TAKE_W  2
+#endif
+
+struct pl_async_waiter;
+
+/* callback called with the lock held, and the waiter record */
+typedef void (*pl_async_cb)(struct pl_async_waiter *w);
+
+/* waiter record, allocated by the caller, and which must remain valid until
+ * its callback is called.
+ */
+struct pl_async_waiter {
+	struct pl_async_waiter *next;
+	pl_async_cb cb;
+	void *arg;
+	int type;
+};
+
+struct pl_async_lock {
+	unsigned long lock;
+	struct pl_async_waiter *waiters;
+};
+
+/* returns the mask of the lock bits preventing lock type <type> from being
+ * taken. W also needs the readers to be gone, see pl_async_try_w().
+ */
+#define pl_async_mask(type)                                                                    \
+	(((type) == PL_TAKE_R) ?                                                               \
+	 ((sizeof(long) == 8) ? (unsigned long)PLOCK64_WL_ANY : (unsigned long)PLOCK32_WL_ANY) : \
+	 ((type) == PL_TAKE_S) ?                                                               \
+	 ((sizeof(long) == 8) ? (unsigned long)(PLOCK64_WL_ANY | PLOCK64_SL_ANY) :            \
+	                        (unsigned long)(PLOCK32_WL_ANY | PLOCK32_SL_ANY)) :            \
+	 ((sizeof(long) == 8) ? (unsigned long)(PLOCK64_WL_ANY | PLOCK64_SL_ANY | PLOCK64_RL_ANY) : \
+	                        (unsigned long)(PLOCK32_WL_ANY | PLOCK32_SL_ANY | PLOCK32_RL_ANY)))
+
+/* Tries to take the W lock on <lock> without ever waiting, returns non-zero on
+ * success. Contrary to pl_try_w(), it fails if readers are present instead of
+ * waiting for them to leave, since they may be waiters granted by the current
+ * thread whose callback did not run yet, or tasks sitting in a wake queue.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static int pl_async_try_w(unsigned long *lock)
+{
+	const unsigned long mask = pl_async_mask(PL_TAKE_W);
+	const unsigned long bits = (sizeof(long) == 8) ?
+		(unsigned long)(PLOCK64_WL_1 | PLOCK64_SL_1 | PLOCK64_RL_1) :
+		(unsigned long)(PLOCK32_WL_1 | PLOCK32_SL_1 | PLOCK32_RL_1);
+	unsigned long old = pl_load(lock);
+	unsigned long prev;
+
+	while (!(old & mask)) {
+		prev = pl_cmpxchg(lock, old, old + bits);
+		if (prev == old) {
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR | PL_TSAN_ATO);
+			return 1;
+		}
+		old = prev;
+		pl_cpu_relax();
+	}
+	return 0;
+}
+
+/* tries to take lock <lock> for type <type>, returns non-zero on success */
+#define pl_async_try(lock, type)                                                               \
+	(((type) == PL_TAKE_W) ? pl_async_try_w(lock) :                                        \
+	 ((type) == PL_TAKE_S) ? pl_try_s(lock) : pl_try_r(lock))
+
+/* Pushes waiter <w> to the list of lock <al> and sets the waiter bit. Returns
+ * non-zero if the lock appears to have been released in the mean time for the
+ * waiter's type, in which case the caller must run pl_async_dispatch() so that
+ * the waiter is not forgotten.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static int pl_async_queue(struct pl_async_lock *al, struct pl_async_waiter *w)
+{
+	struct pl_async_waiter *head = pl_load(&al->waiters);
+	struct pl_async_waiter *prev;
+	const int type = w->type; /* <w> may be granted once queued */
+
+	while (1) {
+		w->next = head;
+		prev = pl_cmpxchg(&al->waiters, head, w);
+		if (prev == head)
+			break;
+		head = prev;
+		pl_cpu_relax();
+	}
+	return !(pl_ldor(&al->lock, PL_ASYNC_WBIT) & pl_async_mask(type));
+}
+
+/* Grants the lock to the waiters of lock <al> which may now get it, and pushes
+ * the others back. The granted waiters are either appended to the list
+ * pointed to by <wq> (linked using their <next> field) if <wq> is not NULL, or
+ * their callback is called. Waiters are processed in their arrival order.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_async_dispatch(struct pl_async_lock *al, struct pl_async_waiter **wq)
+{
+	struct pl_async_waiter *list, *w, *next, *granted, **tail;
+	int retry;
+
+	granted = NULL;
+	tail = &granted;
+	do {
+		retry = 0;
+		pl_and_noret(&al->lock, ~PL_ASYNC_WBIT);
+		list = pl_xchg(&al->waiters, NULL);
+
+		/* the list is in reverse order */
+		for (w = NULL; list; list = next) {
+			next = list->next;
+			list->next = w;
+			w = list;
+		}
+
+		for (; w; w = next) {
+			next = w->next;
+			if (pl_async_try(&al->lock, w->type)) {
+				w->next = NULL;
+				*tail = w;
+				tail = &w->next;
+			}
+			else
+				retry |= pl_async_queue(al, w);
+		}
+	} while (retry);
+
+	if (wq) {
+		while (*wq)
+			wq = &(*wq)->next;
+		*wq = granted;
+		return;
+	}
+
+	for (w = granted; w; w = next) {
+		next = w->next;
+		w->cb(w);
+	}
+}
+
+/* Tries to take lock <al> for type <type>. Returns non-zero if the lock was
+ * taken, in which case the callback is not called. Otherwise, the waiter
+ * record <w> is queued and zero is returned. The callback <cb> will later be
+ * called with <w> after the lock was taken on its behalf, with <arg> placed in
+ * w->arg. Note that if the lock is released while the record is being queued,
+ * the callback may be called before this function returns.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static int pl_take_async(struct pl_async_lock *al, int type, struct pl_async_waiter *w, pl_async_cb cb, void *arg)
+{
+	if (__builtin_expect(pl_async_try(&al->lock, type), 1))
+		return 1;
+
+	w->cb = cb;
+	w->arg = arg;
+	w->type = type;
+	if (pl_async_queue(al, w))
+		pl_async_dispatch(al, NULL);
+	return 0;
+}
+
+/* request shared read access (R) to <al>, see pl_take_async() */
+#define pl_take_r_async(al, w, cb, arg) pl_take_async((al), PL_TAKE_R, (w), (cb), (arg))
+
+/* request a seek access (S) to <al>, see pl_take_async() */
+#define pl_take_s_async(al, w, cb, arg) pl_take_async((al), PL_TAKE_S, (w), (cb), (arg))
+
+/* request a write access (W) to <al>, see pl_take_async() */
+#define pl_take_w_async(al, w, cb, arg) pl_take_async((al), PL_TAKE_W, (w), (cb), (arg))
+
+/* Releases the lock bits <bits> from lock <al>, and if waiters are present,
+ * grants the lock to those which may now get it. See pl_async_dispatch() for
+ * <wq>.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_drop_async(struct pl_async_lock *al, const unsigned long bits, struct pl_async_waiter **wq)
+{
+	pl_barrier();
+	/* S and W also release the exclusive part */
+	pl_tsan_release(&al->lock, (bits & ((sizeof(long) == 8) ? (unsigned long)PLOCK64_SL_ANY :
+	                                (unsigned long)PLOCK32_SL_ANY)) ?
+	                PL_TSAN_EXC | PL_TSAN_SHR : PL_TSAN_SHR);
+	if (__builtin_expect(pl_ldsub_rel(&al->lock, bits) & PL_ASYNC_WBIT, 0))
+		pl_async_dispatch(al, wq);
+}
+
+/* release the read access (R) lock on <al> */
+#define pl_drop_r_async(al, wq)                                                                \
+	pl_drop_async((al), (sizeof(long) == 8) ?                                              \
+	              (unsigned long)(PLOCK64_RL_1) :                                          \
+	              (unsigned long)(PLOCK32_RL_1), (wq))
+
+/* release the seek access (S) lock on <al> */
+#define pl_drop_s_async(al, wq)                                                                \
+	pl_drop_async((al), (sizeof(long) == 8) ?                                              \
+	              (unsigned long)(PLOCK64_SL_1 | PLOCK64_RL_1) :                           \
+	              (unsigned long)(PLOCK32_SL_1 | PLOCK32_RL_1), (wq))
+
+/* release the write (W) lock on <al> */
+#define pl_drop_w_async(al, wq)                                                                \
+	pl_drop_async((al), (sizeof(long) == 8) ?                                              \
+	              (unsigned long)(PLOCK64_WL_1 | PLOCK64_SL_1 | PLOCK64_RL_1) :            \
+	              (unsigned long)(PLOCK32_WL_1 | PLOCK32_SL_1 | PLOCK32_RL_1), (wq))
+
+#endif /* PL_ASYNC_H */
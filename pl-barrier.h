@@ -0,0 +1,167 @@
+/* plock - thread barriers
+ *
+ * Copyright (C) 2026 Willy Tarreau <w@1wt.eu>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PL_BARRIER_H
+#define PL_BARRIER_H
+
+/* The functions below implement a reusable thread barrier based on a
+ * combining tree, so that the arrivals do not all hit the same cache line.
+ * Threads arrive on a leaf node shared with up to PL_BARRIER_FANIN-1 other
+ * threads, and the last one to arrive on a node continues to the parent node,
+ * up to the root. The last thread to arrive on the root releases everyone by
+ * advancing the phase word, on which all threads wait. Since each thread only
+ * compares the phase with the one it saw when arriving, the barrier may be
+ * called back to back without any reset, the node counters being reset by
+ * their last arrival before the phase changes. Threads with close IDs share
+ * the same leaf, so that threads numbered along the CPU topology (e.g. by
+ * core then package) mostly combine their arrivals within the same cache
+ * domain.
+ *
+ * The wait either spins with an exponential backoff (pl_barrier_spin()), or
+ * additionally sleeps on the phase word's futex after a short spin
+ * (pl_barrier_wait()), for barriers which may last long. Both may be mixed on
+ * the same barrier. Bit 0 of the phase word is the waiter bit used by
+ * pl_sleep_new_int(), the phase is advanced by 2.
+ *
+ * Each arrival is a release, the last arrival on a node acquires the other
+ * ones, and every waiter leaves with an acquire barrier after seeing the phase
+ * change, so that all memory writes performed by any thread before the barrier
+ * are visible to all threads after it, whatever the wait method.
+ */
+
+#include "pl-futex.h"
+
+#define PL_BARRIER_FANIN 4
+
+struct pl_barrier_node {
+	unsigned int count;   /* arrivals during the current phase */
+	unsigned int total;   /* arrivals expected on this node */
+	unsigned int parent;  /* parent node index, ~0U for the root */
+} __attribute__((aligned(64)));
+
+struct pl_barrier {
+	unsigned int phase;              /* advanced by 2 by the last arrival */
+	unsigned int threads;            /* number of participating threads */
+	struct pl_barrier_node *nodes;   /* one node per thread is enough */
+} __attribute__((aligned(64)));
+
+/* Initializes barrier <b> for <threads> threads (at least one), using the
+ * caller-allocated array <nodes> which must contain at least <threads>
+ * entries. Leaves are placed first, then each level up to the root.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_barrier_init(struct pl_barrier *b, struct pl_barrier_node *nodes, unsigned int threads)
+{
+	unsigned int first = 0; /* first node of the current level */
+	unsigned int width = threads; /* number of arrivals on the current level */
+	unsigned int nb, i;
+
+	b->phase = 0;
+	b->threads = threads;
+	b->nodes = nodes;
+
+	while (1) {
+		nb = (width + PL_BARRIER_FANIN - 1) / PL_BARRIER_FANIN;
+		for (i = 0; i < nb; i++) {
+			nodes[first + i].count = 0;
+			nodes[first + i].total = (i < nb - 1 || !(width % PL_BARRIER_FANIN)) ?
+				PL_BARRIER_FANIN : width % PL_BARRIER_FANIN;
+			nodes[first + i].parent = (nb == 1) ? ~0U : first + nb + i / PL_BARRIER_FANIN;
+		}
+		if (nb == 1)
+			break;
+		first += nb;
+		width = nb;
+	}
+}
+
+/* Registers the arrival of thread <thr> (0 to threads-1) on barrier <b>, and
+ * returns the phase to wait for if other threads are still expected, or ~0U
+ * if this thread was the last one, in which case the barrier was released.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static unsigned int pl_barrier_arrive(struct pl_barrier *b, unsigned int thr)
+{
+	unsigned int phase = pl_deref_int(&b->phase) & ~1U;
+	unsigned int idx = thr / PL_BARRIER_FANIN;
+	struct pl_barrier_node *node;
+
+	while (1) {
+		node = &b->nodes[idx];
+		pl_mb_store();
+		if (pl_ldadd(&node->count, 1) + 1 != node->total)
+			return phase;
+		/* last one on this node, nobody will touch it before the
+		 * phase changes. Others' writes must be visible to those
+		 * we are going to release.
+		 */
+		pl_mb_load();
+		pl_store(&node->count, 0);
+		idx = node->parent;
+		if (idx == ~0U)
+			break;
+	}
+
+	pl_mb_store();
+	pl_notify_int(&b->phase, phase + 2, 1);
+	return ~0U;
+}
+
+/* Waits on barrier <b> for all threads to arrive, thread <thr> being the
+ * caller. Spins with an exponential backoff, then sleeps. Returns non-zero
+ * for the last thread to arrive, similar to PTHREAD_BARRIER_SERIAL_THREAD.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static int pl_barrier_wait(struct pl_barrier *b, unsigned int thr)
+{
+	unsigned int phase = pl_barrier_arrive(b, thr);
+
+	if (phase == ~0U)
+		return 1;
+	pl_sleep_new_int(&b->phase, phase, 1);
+	pl_mb_load();
+	return 0;
+}
+
+/* Same as pl_barrier_wait() but only spins with an exponential backoff,
+ * which offers the lowest latency when all threads have their own CPU.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static int pl_barrier_spin(struct pl_barrier *b, unsigned int thr)
+{
+	unsigned int phase = pl_barrier_arrive(b, thr);
+	unsigned int curr;
+
+	if (phase == ~0U)
+		return 1;
+	curr = phase;
+	do {
+		curr = pl_wait_new_int(&b->phase, curr);
+	} while ((curr & ~1U) == phase);
+	pl_mb_load();
+	return 0;
+}
+
+#endif /* PL_BARRIER_H */
@@ -0,0 +1,170 @@
+/* plock - atomic multi-word bitmaps
+ *
+ * Copyright (C) 2026 Willy Tarreau <w@1wt.eu>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PL_BITMAP_H
+#define PL_BITMAP_H
+
+/* The functions below operate on bitmaps made of arrays of longs, such as
+ * thread masks or ID allocation maps larger than a single word. Bit <n> is bit
+ * <n % PL_BITMAP_LBITS> of word <n / PL_BITMAP_LBITS>. Setting and clearing
+ * bits rely on pl_bts() and pl_btr(), which use a single locked instruction
+ * returning the carry flag on x86. The bitmap as a whole is not atomic, so
+ * that readers needing a consistent view of all words take a snapshot first
+ * and iterate over it.
+ */
+
+#include "plock.h"
+
+/* number of bits per word, and number of words needed for <bits> bits */
+#define PL_BITMAP_LBITS       (sizeof(long) * 8)
+#define PL_BITMAP_LONGS(bits) (((bits) + PL_BITMAP_LBITS - 1) / PL_BITMAP_LBITS)
+
+/* atomically sets bit <bit> in bitmap <map>. Returns non-zero if it was
+ * already set.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static int pl_bitmap_set(unsigned long *map, unsigned int bit)
+{
+	return !!pl_bts(&map[bit / PL_BITMAP_LBITS], bit % PL_BITMAP_LBITS);
+}
+
+/* atomically clears bit <bit> in bitmap <map>. Returns non-zero if it was
+ * set.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static int pl_bitmap_clear(unsigned long *map, unsigned int bit)
+{
+	return !!pl_btr(&map[bit / PL_BITMAP_LBITS], bit % PL_BITMAP_LBITS);
+}
+
+/* returns non-zero if bit <bit> is set in bitmap <map> */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static int pl_bitmap_test(const unsigned long *map, unsigned int bit)
+{
+	return !!(pl_load(&map[bit / PL_BITMAP_LBITS]) & (1UL << (bit % PL_BITMAP_LBITS)));
+}
+
+/* Finds the first zero bit of bitmap <map> of <words> words, starting at word
+ * <hint> and wrapping, and atomically sets it. Different threads may pass
+ * different hints to spread the contention over multiple words. Returns the
+ * bit number, or -1 if all bits were found set or if the map is empty.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static long pl_bitmap_claim(unsigned long *map, unsigned int words, unsigned int hint)
+{
+	unsigned long word;
+	unsigned int w, n, bit;
+
+	if (!words)
+		return -1;
+
+	w = hint < words ? hint : hint % words;
+	for (n = 0; n < words; n++) {
+		word = pl_load(&map[w]);
+		while (~word) {
+			bit = __builtin_ctzl(~word);
+			if (!pl_bts(&map[w], bit))
+				return (long)w * PL_BITMAP_LBITS + bit;
+			/* lost the race, let's check the bits left in this word */
+			pl_cpu_relax();
+			word = pl_load(&map[w]);
+		}
+		if (++w == words)
+			w = 0;
+	}
+	return -1;
+}
+
+/* returns the number of bits set in bitmap <map> of <words> words. Words are
+ * read one at a time, so the result is only exact if the map did not change.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static unsigned long pl_bitmap_count(const unsigned long *map, unsigned int words)
+{
+	unsigned long count = 0;
+	unsigned int w;
+
+	for (w = 0; w < words; w++)
+		count += __builtin_popcountl(pl_load(&map[w]));
+	return count;
+}
+
+/* Copies bitmap <map> of <words> words into <snap>, and reads it again until
+ * two consecutive copies match, so that the snapshot is one state the map was
+ * in, unless a bit was changed and restored in between. It gives up after
+ * <tries> attempts (at least one). Returns non-zero if the snapshot is
+ * consistent, otherwise <snap> contains the last copy.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static int pl_bitmap_snapshot(unsigned long *snap, const unsigned long *map, unsigned int words, unsigned int tries)
+{
+	unsigned long word;
+	unsigned int w, diff;
+
+	for (w = 0; w < words; w++)
+		snap[w] = pl_load(&map[w]);
+
+	while (tries--) {
+		pl_mb_load();
+		for (w = diff = 0; w < words; w++) {
+			word = pl_load(&map[w]);
+			diff |= word != snap[w];
+			snap[w] = word;
+		}
+		if (!diff)
+			return 1;
+	}
+	return 0;
+}
+
+/* returns the number of the first bit set in bitmap <map> of <words> words at
+ * or after bit <bit>, or -1 if there is none. The map is expected to be a
+ * snapshot.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static long pl_bitmap_next(const unsigned long *map, unsigned int words, unsigned long bit)
+{
+	unsigned long w = bit / PL_BITMAP_LBITS;
+	unsigned long word;
+
+	if (w >= words)
+		return -1;
+	word = map[w] & (~0UL << (bit % PL_BITMAP_LBITS));
+	while (!word) {
+		if (++w >= words)
+			return -1;
+		word = map[w];
+	}
+	return (long)(w * PL_BITMAP_LBITS + __builtin_ctzl(word));
+}
+
+/* iterates over all bits set in bitmap <map> of <words> words, with <bit> (a
+ * long) holding each bit number. The map is expected to be a snapshot.
+ */
+#define pl_bitmap_foreach(map, words, bit)                                     \
+	for ((bit) = pl_bitmap_next((map), (words), 0); (bit) >= 0;            \
+	     (bit) = pl_bitmap_next((map), (words), (bit) + 1))
+
+#endif /* PL_BITMAP_H */
@@ -0,0 +1,223 @@
+/* plock - epoch-based memory reclamation
+ *
+ * Copyright (C) 2026 Willy Tarreau <w@1wt.eu>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PL_EBR_H
+#define PL_EBR_H
+
+/* The functions below implement epoch-based memory reclamation, which allows
+ * readers to access shared objects without any lock nor refcount, and writers
+ * to release the objects they removed once no reader may still see them.
+ *
+ * A global epoch is advanced in steps of 2 (bit 0 being used to mark active
+ * threads). Each thread announces the global epoch it observed when entering
+ * a critical section using pl_ebr_enter(), and clears it with pl_ebr_leave().
+ * Objects removed from shared structures are passed to pl_ebr_retire(), which
+ * places them into the calling thread's limbo list for the global epoch G
+ * seen after the removal. Only threads which announced G or less may still
+ * reference them. The epoch may only advance once all active threads have
+ * announced it, so once it reaches G+4 (two epochs later), all such threads
+ * have left, and the objects are freed in batches when the retiring thread
+ * observes it. Note that G is not the retiring thread's announced epoch, which
+ * may be one epoch behind. Since a thread announcing S may only retire objects
+ * up to S+2 and frees those up to S-4, three limbo lists per thread are
+ * enough. Every PL_EBR_BATCH retired objects, the retiring thread tries to
+ * advance the epoch.
+ *
+ * Critical sections must not be nested, and a thread which stays in a
+ * critical section blocks the reclamation for all others. The per-thread
+ * contexts are allocated by the caller, one per thread on its own cache line,
+ * and are identified by the thread number.
+ */
+
+#include "plock.h"
+
+#ifndef PL_EBR_BATCH
+#define PL_EBR_BATCH 64
+#endif
+
+/* the part to embed into retired objects */
+struct pl_ebr_node {
+	struct pl_ebr_node *next;
+	void (*free)(struct pl_ebr_node *node);   /* called once unreachable */
+};
+
+struct pl_ebr_thread {
+	unsigned long epoch;                /* announced epoch | 1 when active */
+	unsigned long seen;                 /* last epoch collect was called for */
+	struct pl_ebr_node *limbo[3];       /* retired per global epoch modulo 3 */
+	unsigned int retired;               /* retired since last advance attempt */
+} __attribute__((aligned(64)));
+
+struct pl_ebr {
+	unsigned long epoch;                /* global epoch, advanced by 2 */
+	unsigned int threads;               /* number of entries in <th> */
+	struct pl_ebr_thread *th;           /* one entry per thread */
+} __attribute__((aligned(64)));
+
+/* returns the limbo list index for epoch <e> */
+#define pl_ebr_idx(e) (((e) >> 1) % 3)
+
+/* Initializes epoch reclamation context <ebr> for <threads> threads using the
+ * caller-allocated array <th> of <threads> entries.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_ebr_init(struct pl_ebr *ebr, struct pl_ebr_thread *th, unsigned int threads)
+{
+	unsigned int i;
+
+	ebr->epoch = 2;
+	ebr->threads = threads;
+	ebr->th = th;
+	for (i = 0; i < threads; i++) {
+		th[i].epoch = 0;
+		th[i].seen = 2;
+		th[i].limbo[0] = th[i].limbo[1] = th[i].limbo[2] = NULL;
+		th[i].retired = 0;
+	}
+}
+
+/* calls the free callback of all nodes in list <list> */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_ebr_free_list(struct pl_ebr_node *list)
+{
+	struct pl_ebr_node *next;
+
+	for (; list; list = next) {
+		next = list->next;
+		list->free(list);
+	}
+}
+
+/* Frees the objects of thread <th> retired at global epoch <e>-4 or before,
+ * if not yet done. Since the previous call for epoch S freed those up to S-4,
+ * and the thread may have retired objects up to S+2 since, only the lists for
+ * S-2, S and S+2 may be populated.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_ebr_collect(struct pl_ebr_thread *th, unsigned long e)
+{
+	struct pl_ebr_node *list;
+	unsigned long g;
+
+	if (__builtin_expect(th->seen == e, 1))
+		return;
+
+	for (g = th->seen - 2; g <= th->seen + 2 && g + 4 <= e; g += 2) {
+		list = th->limbo[pl_ebr_idx(g)];
+		th->limbo[pl_ebr_idx(g)] = NULL;
+		pl_ebr_free_list(list);
+	}
+	th->seen = e;
+}
+
+/* Enters a critical section for thread <thr>. The global epoch is announced
+ * with a full barrier so that no shared pointer may be loaded before it is
+ * visible, and is checked again in case it advanced in the mean time without
+ * seeing the announce. Objects retired by this thread two epochs ago are
+ * freed.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_ebr_enter(struct pl_ebr *ebr, unsigned int thr)
+{
+	struct pl_ebr_thread *th = &ebr->th[thr];
+	unsigned long e, prev;
+
+	e = pl_load(&ebr->epoch);
+	do {
+		prev = e;
+		pl_xchg(&th->epoch, e | 1);
+		e = pl_load(&ebr->epoch);
+	} while (__builtin_expect(e != prev, 0));
+	pl_ebr_collect(th, e);
+}
+
+/* Leaves the critical section of thread <thr>. No pointer loaded during the
+ * critical section may be used afterwards.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_ebr_leave(struct pl_ebr *ebr, unsigned int thr)
+{
+	pl_store(&ebr->th[thr].epoch, 0);
+}
+
+/* Tries to advance the global epoch of <ebr>, which is only possible when all
+ * active threads have announced the current one. Returns non-zero on success
+ * or if another thread succeeded.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static int pl_ebr_advance(struct pl_ebr *ebr)
+{
+	unsigned long e = pl_load(&ebr->epoch);
+	unsigned long te;
+	unsigned int i;
+
+	pl_mb();
+	for (i = 0; i < ebr->threads; i++) {
+		te = pl_load(&ebr->th[i].epoch);
+		if ((te & 1) && te != (e | 1))
+			return 0;
+	}
+	pl_cmpxchg(&ebr->epoch, e, e + 2);
+	return 1;
+}
+
+/* Retires object <node> removed from a shared structure by thread <thr>, which
+ * must be in a critical section. Its free callback <free> will be called once
+ * no thread may reference it anymore. The global epoch is read after a full
+ * barrier, so that any thread which could still find the node announced it
+ * or an older one. Every PL_EBR_BATCH calls, an attempt is made to advance
+ * the global epoch.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_ebr_retire(struct pl_ebr *ebr, unsigned int thr, struct pl_ebr_node *node, void (*free)(struct pl_ebr_node *))
+{
+	struct pl_ebr_thread *th = &ebr->th[thr];
+	unsigned int idx;
+
+	pl_mb();
+	idx = pl_ebr_idx(pl_load(&ebr->epoch));
+
+	node->free = free;
+	node->next = th->limbo[idx];
+	th->limbo[idx] = node;
+	if (__builtin_expect(++th->retired >= PL_EBR_BATCH, 0)) {
+		th->retired = 0;
+		pl_ebr_advance(ebr);
+	}
+}
+
+/* Tries to advance the epoch and to free the objects retired by thread <thr>,
+ * which must not be in a critical section. This is meant to be called by idle
+ * threads or before exiting, and may need to be called twice for all of
+ * them to be freed if other threads are not active.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_ebr_reclaim(struct pl_ebr *ebr, unsigned int thr)
+{
+	pl_ebr_advance(ebr);
+	pl_ebr_collect(&ebr->th[thr], pl_load(&ebr->epoch));
+}
+
+#endif /* PL_EBR_H */
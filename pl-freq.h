@@ -0,0 +1,158 @@
+/* plock - lock-free frequency counters
+ *
+ * Copyright (C) 2026 Willy Tarreau <w@1wt.eu>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PL_FREQ_H
+#define PL_FREQ_H
+
+/* The functions below implement event rate counters over a sliding window of
+ * one period, which may be updated concurrently by many threads. The counter
+ * is made of the number of events of the current period, and of the previous
+ * one. Within a period, an update costs a single XADD. When the period is
+ * over, the first updater to notice it locks the counter by setting the low
+ * bit of the tick using pl_cmpxchg(), moves the current count to the previous
+ * one, and releases it with the new tick. Concurrent updaters do not wait for
+ * the rotation, their event is accounted either to the previous or to the new
+ * period. The rate is estimated by adding to the current count the part of
+ * the previous one which remains in the sliding window, which assumes that
+ * events were evenly distributed over the previous period.
+ *
+ * Time is expressed in ticks of any unit (e.g. milliseconds) passed by the
+ * caller as a 32-bit value which may wrap. The tick is stored shifted left by
+ * one to leave room for the lock bit, so that periods must be shorter than
+ * 2^30 ticks, and that a counter left idle for more than 2^31 ticks minus one
+ * period may count its next events into an old period. A zero tick, as set by
+ * PL_FREQ_CTR_INITIALIZER, means that no period was started yet, and the
+ * first update starts one.
+ */
+
+#include "plock.h"
+
+struct pl_freq_ctr {
+	unsigned int tick;          /* start of the current period << 1, bit 0 = locked */
+	unsigned int curr;          /* events in the current period */
+	unsigned int prev;          /* events in the previous period */
+};
+
+#define PL_FREQ_CTR_INITIALIZER { 0, 0, 0 }
+
+/* returns the number of ticks elapsed at <now> since the period start of
+ * stored tick <tick>, modulo 2^31. If <now> was retrieved by a thread before
+ * another one rotated the period, it is slightly before the period start and
+ * the result is close to 2^31, which pl_freq_early() detects.
+ */
+#define pl_freq_elapsed(tick, now) ((((now) << 1) - ((tick) & ~1U)) >> 1)
+
+/* returns non-zero if <elapsed> as returned by pl_freq_elapsed() corresponds
+ * to a date less than one period <period> before the period start.
+ */
+#define pl_freq_early(elapsed, period) ((elapsed) >= (1U << 31) - (period))
+
+/* Adds <inc> events at date <now> to counter <ctr> of period <period>, and
+ * returns the updated number of events of the current period.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static unsigned int pl_freq_update(struct pl_freq_ctr *ctr, unsigned int period, unsigned int now, unsigned int inc)
+{
+	unsigned int tick, prev, curr, elapsed;
+
+	tick = pl_load(&ctr->tick);
+	while (1) {
+		elapsed = pl_freq_elapsed(tick, now);
+		if (__builtin_expect(tick != 0, 1) &&
+		    (__builtin_expect(elapsed < period, 1) || (tick & 1) ||
+		     pl_freq_early(elapsed, period))) {
+			/* current period, or rotation in progress */
+			return pl_xadd(&ctr->curr, inc) + inc;
+		}
+
+		/* the period is over, try to be the one rotating */
+		prev = pl_cmpxchg(&ctr->tick, tick, tick | 1);
+		if (prev == tick)
+			break;
+		tick = prev;
+		pl_cpu_relax();
+	}
+
+	/* we own the lock, the previous period is either the one which just
+	 * ended, or is empty if more than one period elapsed or if none was
+	 * started. A new period cannot start at zero, which means unset.
+	 */
+	curr = pl_xchg(&ctr->curr, inc);
+	if (tick && elapsed < 2 * period) {
+		pl_store(&ctr->prev, curr);
+		tick += period << 1;
+	}
+	else {
+		pl_store(&ctr->prev, 0);
+		tick = now << 1;
+	}
+	if (!tick)
+		tick = 2;
+	pl_mb_store();
+	pl_store(&ctr->tick, tick);
+	return inc;
+}
+
+/* Returns the number of events of counter <ctr> of period <period> over the
+ * last period before date <now>, estimated from the current and previous
+ * periods' counts.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static unsigned int pl_freq_read(const struct pl_freq_ctr *ctr, unsigned int period, unsigned int now)
+{
+	unsigned int tick, curr, prev, elapsed;
+
+	while (1) {
+		tick = pl_load(&ctr->tick);
+		if (tick & 1) {
+			pl_cpu_relax();
+			continue;
+		}
+		pl_mb_load();
+		curr = pl_load(&ctr->curr);
+		prev = pl_load(&ctr->prev);
+		pl_mb_load();
+		if (pl_load(&ctr->tick) == tick)
+			break;
+	}
+
+	if (!tick)
+		return 0; /* never updated */
+
+	elapsed = pl_freq_elapsed(tick, now);
+	if (pl_freq_early(elapsed, period))
+		elapsed = 0;
+	else if (elapsed >= period) {
+		/* not rotated yet: the current period is the previous one */
+		if (elapsed >= 2 * period)
+			return 0;
+		prev = curr;
+		curr = 0;
+		elapsed -= period;
+	}
+	return curr + (unsigned int)((unsigned long long)prev * (period - elapsed) / period);
+}
+
+#endif /* PL_FREQ_H */
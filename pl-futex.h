@@ -0,0 +1,653 @@
+/* plock - futex-based waiting on lock words
+ *
+ * Copyright (C) 2026 Willy Tarreau <w@1wt.eu>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PL_FUTEX_H
+#define PL_FUTEX_H
+
+/* The functions below extend pl_wait_new_long() and pl_wait_new_int() for
+ * waits which may last long (e.g. milliseconds), for which spinning would
+ * waste CPU. The waiter spins for a short time, then flags its presence by
+ * setting a bit reserved by the caller in the word (<wbit>), and sleeps in
+ * FUTEX_WAIT on the 32-bit half of the word holding this bit. The notifier
+ * changes the word using an atomic operation which clears <wbit> and only
+ * calls FUTEX_WAKE if the bit was set, so that the uncontended notification
+ * costs a single atomic operation.
+ *
+ * On non-Linux systems, the sleep is replaced with sched_yield() (or a CPU
+ * relax instruction when unavailable) and the wakeup is a no-op, so that the
+ * same code remains usable, only less efficiently.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include "plock.h"
+
+#include <unistd.h>
+#include <sched.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+/* returns a pointer to the 32-bit half of the long pointed to by <ptr> which
+ * holds the bits from <mask>, which must all be located in the same half. On
+ * 32-bit platforms it's the word itself.
+ */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define pl_futex_word(ptr, mask)                                                               \
+	((unsigned int *)(ptr) + ((sizeof(long) == 8 && !(((mask) >> 16 >> 16) & ~0U)) ? 1 : 0))
+#else
+#define pl_futex_word(ptr, mask)                                                               \
+	((unsigned int *)(ptr) + ((sizeof(long) == 8 && (((mask) >> 16 >> 16) & ~0U)) ? 1 : 0))
+#endif
+
+/* returns the shift to apply to a long to retrieve the 32-bit half holding
+ * the bits from <mask>.
+ */
+#define pl_futex_shift(mask)                                                                   \
+	((sizeof(long) == 8 && (((mask) >> 16 >> 16) & ~0U)) ? 32 : 0)
+
+#if defined(__linux__)
+
+/* sleeps on the 32-bit word <uaddr> as long as it contains <val>. Returns
+ * zero when woken up, otherwise -1 with errno set (e.g. EAGAIN if the value
+ * didn't match, EINTR on signal). Spurious wakeups are possible.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static long pl_futex_wait(const unsigned int *uaddr, unsigned int val)
+{
+	/* syscall() is declared as a leaf function, so the compiler may assume
+	 * that the caller's file-local variables cannot change while sleeping
+	 * and not reload them after the wait. Calling it through a volatile
+	 * pointer prevents this.
+	 */
+	static long (*volatile sys)(long, ...) = syscall;
+
+	return sys(SYS_futex, uaddr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+/* wakes up to <nr> threads sleeping on the 32-bit word <uaddr>. Returns the
+ * number of threads woken up, or -1 with errno set.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static long pl_futex_wake(const unsigned int *uaddr, int nr)
+{
+	return syscall(SYS_futex, uaddr, FUTEX_WAKE_PRIVATE, nr, NULL, NULL, 0);
+}
+
+/* wakes up to <nr> threads sleeping on the 32-bit word <uaddr> and moves up
+ * to <nr2> other ones to the wait queue of <uaddr2>, provided that <uaddr>
+ * still contains <val>. Returns the number of threads woken up or requeued,
+ * otherwise -1 with errno set (e.g. EAGAIN if the value didn't match).
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static long pl_futex_requeue(const unsigned int *uaddr, int nr, const unsigned int *uaddr2, int nr2, unsigned int val)
+{
+	return syscall(SYS_futex, uaddr, FUTEX_CMP_REQUEUE_PRIVATE, nr, (unsigned long)nr2, uaddr2, val);
+}
+
+#if defined(SYS_futex_waitv) && defined(FUTEX_WAITV_MAX)
+#define PL_FUTEX_WAITV_MAX FUTEX_WAITV_MAX
+
+/* sleeps on the <nb> 32-bit words <uaddr[]> as long as each of them contains
+ * its respective value from <val[]>. Requires Linux 5.16 or above. Returns the
+ * index of the word that was woken up, otherwise -1 with errno set (e.g.
+ * EAGAIN if one value didn't match, ENOSYS on older kernels). Spurious wakeups
+ * are possible. <nb> must not be larger than PL_FUTEX_WAITV_MAX.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static long pl_futex_waitv(unsigned int * const *uaddr, const unsigned int *val, unsigned int nb)
+{
+	static long (*volatile sys)(long, ...) = syscall; /* see pl_futex_wait() */
+	struct futex_waitv w[nb];
+	unsigned int i;
+
+	for (i = 0; i < nb; i++) {
+		w[i].val = val[i];
+		w[i].uaddr = (unsigned long)uaddr[i];
+		w[i].flags = FUTEX_32 | FUTEX_PRIVATE_FLAG;
+		w[i].__reserved = 0;
+	}
+	return sys(SYS_futex_waitv, w, nb, 0, NULL, 0);
+}
+#endif /* SYS_futex_waitv */
+
+#else /* !__linux__ */
+
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static long pl_futex_wait(const unsigned int *uaddr, unsigned int val)
+{
+	(void)uaddr; (void)val;
+#ifdef _POSIX_PRIORITY_SCHEDULING
+	sched_yield();
+#else
+	pl_cpu_relax();
+#endif
+	return 0;
+}
+
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static long pl_futex_wake(const unsigned int *uaddr, int nr)
+{
+	(void)uaddr; (void)nr;
+	return 0;
+}
+
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static long pl_futex_requeue(const unsigned int *uaddr, int nr, const unsigned int *uaddr2, int nr2, unsigned int val)
+{
+	(void)uaddr; (void)nr; (void)uaddr2; (void)nr2; (void)val;
+	return 0;
+}
+
+#endif /* __linux__ */
+
+#ifndef PL_FUTEX_WAITV_MAX
+#define PL_FUTEX_WAITV_MAX 128
+
+/* futex_waitv() is not available, only pretend to sleep */
+__attribute__((unused,noinline,no_instrument_function))
+static long pl_futex_waitv(unsigned int * const *uaddr, const unsigned int *val, unsigned int nb)
+{
+	(void)uaddr; (void)val; (void)nb;
+#ifdef _POSIX_PRIORITY_SCHEDULING
+	sched_yield();
+#else
+	pl_cpu_relax();
+#endif
+	return 0;
+}
+#endif /* PL_FUTEX_WAITV_MAX */
+
+/* This function waits for <lock> to change from value <prev>, ignoring bit(s)
+ * <wbit>, and returns the new value, which may contain <wbit>. It first spins
+ * with the same exponential backoff as pl_wait_new_long() for up to 255 CPU
+ * pauses at once, then sets <wbit> in the word to indicate its presence, and
+ * sleeps in the kernel until woken up by pl_notify_long() or pl_wake_long().
+ * <wbit> must be reserved for this usage in the word, and the 32-bit half of
+ * the word holding it will be used as the futex.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static unsigned long pl_sleep_new_long(unsigned long *lock, const unsigned long prev, const unsigned long wbit)
+{
+	unsigned int *word = pl_futex_word(lock, wbit);
+	unsigned int shift = pl_futex_shift(wbit);
+	unsigned char m = 0;
+	unsigned long curr;
+
+	do {
+		unsigned char loops = m + 1;
+		m = (m << 1) + 1;
+		do {
+			pl_cpu_relax();
+		} while (__builtin_expect(--loops, 0));
+		curr = pl_deref_long(lock);
+		if ((curr & ~wbit) != (prev & ~wbit))
+			return curr;
+	} while (m != 255);
+
+	while (1) {
+		curr = pl_ldor(lock, wbit);
+		if ((curr & ~wbit) != (prev & ~wbit))
+			return curr;
+		pl_futex_wait(word, (unsigned int)((curr | wbit) >> shift));
+		curr = pl_deref_long(lock);
+		if ((curr & ~wbit) != (prev & ~wbit))
+			return curr;
+	}
+}
+
+/* This function waits for <lock> to change from value <prev>, ignoring bit(s)
+ * <wbit>, and returns the new value, which may contain <wbit>. It first spins
+ * with the same exponential backoff as pl_wait_new_int() for up to 255 CPU
+ * pauses at once, then sets <wbit> in the word to indicate its presence, and
+ * sleeps in the kernel until woken up by pl_notify_int() or pl_wake_int().
+ * <wbit> must be reserved for this usage in the word.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static unsigned int pl_sleep_new_int(unsigned int *lock, const unsigned int prev, const unsigned int wbit)
+{
+	unsigned char m = 0;
+	unsigned int curr;
+
+	do {
+		unsigned char loops = m + 1;
+		m = (m << 1) + 1;
+		do {
+			pl_cpu_relax();
+		} while (__builtin_expect(--loops, 0));
+		curr = pl_deref_int(lock);
+		if ((curr & ~wbit) != (prev & ~wbit))
+			return curr;
+	} while (m != 255);
+
+	while (1) {
+		curr = pl_ldor(lock, wbit);
+		if ((curr & ~wbit) != (prev & ~wbit))
+			return curr;
+		pl_futex_wait(lock, curr | wbit);
+		curr = pl_deref_int(lock);
+		if ((curr & ~wbit) != (prev & ~wbit))
+			return curr;
+	}
+}
+
+/* Wakes up the threads sleeping in pl_sleep_new_long() on <lock> if <old>,
+ * the value returned by the atomic operation which changed the word and
+ * cleared <wbit>, indicates that some waiters flagged their presence.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_wake_long(unsigned long *lock, const unsigned long old, const unsigned long wbit)
+{
+	if (__builtin_expect(old & wbit, 0))
+		pl_futex_wake(pl_futex_word(lock, wbit), INT_MAX);
+}
+
+/* Wakes up the threads sleeping in pl_sleep_new_int() on <lock> if <old>,
+ * the value returned by the atomic operation which changed the word and
+ * cleared <wbit>, indicates that some waiters flagged their presence.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_wake_int(unsigned int *lock, const unsigned int old, const unsigned int wbit)
+{
+	if (__builtin_expect(old & wbit, 0))
+		pl_futex_wake(lock, INT_MAX);
+}
+
+/* Atomically sets <lock> to <new> without <wbit>, wakes up the threads
+ * waiting for it in pl_sleep_new_long() if any flagged its presence, and
+ * returns the previous value. This only costs an XCHG when nobody sleeps.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static unsigned long pl_notify_long(unsigned long *lock, const unsigned long new, const unsigned long wbit)
+{
+	unsigned long old = pl_xchg(lock, new & ~wbit);
+
+	pl_wake_long(lock, old, wbit);
+	return old;
+}
+
+/* Atomically sets <lock> to <new> without <wbit>, wakes up the threads
+ * waiting for it in pl_sleep_new_int() if any flagged its presence, and
+ * returns the previous value. This only costs an XCHG when nobody sleeps.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static unsigned int pl_notify_int(unsigned int *lock, const unsigned int new, const unsigned int wbit)
+{
+	unsigned int old = pl_xchg(lock, new & ~wbit);
+
+	pl_wake_int(lock, old, wbit);
+	return old;
+}
+
+/* Lock types for pl_take_any() */
+#define PL_TAKE_R  0
+#define PL_TAKE_S  1
+#define PL_TAKE_W  2
+
+/* This function takes the lock of type <type> (one of PL_TAKE_R, PL_TAKE_S or
+ * PL_TAKE_W) on whichever of the <nb> unsigned long locks pointed to by
+ * <locks[]> becomes available first, and returns its index. It first spins
+ * over the whole set with an exponential backoff of up to 255 CPU pauses, then
+ * sets the waiter bit <wbit> on all locks still unavailable, and sleeps on all
+ * of them at once using futex_waitv() (Linux 5.16+), until woken up by one of
+ * the pl_drop_{r,s,w}_wake() functions. <wbit> must be one of the two lowest
+ * bits of the lock, which are reserved for the application, and all releases
+ * of these locks must be performed using pl_drop_{r,s,w}_wake(), otherwise a
+ * sleeping waiter could miss the wakeup. The futex is placed on the 32-bit
+ * half of each lock holding <wbit>, which is also where the readers count is
+ * located, so that any release also changes the futex value. When more than
+ * PL_FUTEX_WAITV_MAX locks are passed, or when futex_waitv() is not supported,
+ * the sleep is replaced with sched_yield(). <nb> must be at least 1.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static unsigned int pl_take_any(unsigned long **locks, unsigned int nb, const unsigned long wbit, int type)
+{
+	const unsigned long wmsk = (sizeof(long) == 8) ? (unsigned long)PLOCK64_WL_ANY : (unsigned long)PLOCK32_WL_ANY;
+	const unsigned long smsk = (sizeof(long) == 8) ? (unsigned long)PLOCK64_SL_ANY : (unsigned long)PLOCK32_SL_ANY;
+	const unsigned long msk = (type == PL_TAKE_R) ? wmsk : wmsk | smsk;
+	const unsigned int shift = pl_futex_shift(wbit);
+	unsigned int *uaddr[nb <= PL_FUTEX_WAITV_MAX ? nb : 1];
+	unsigned int val[nb <= PL_FUTEX_WAITV_MAX ? nb : 1];
+	unsigned char m = 0;
+	unsigned long curr;
+	unsigned int i;
+	long ret = 0;
+
+	/* the try functions only apply a single atomic op when the lock looks
+	 * available and rely on the lock's size, hence the unsigned long type.
+	 */
+#define __pl_take_one(lock) ((type == PL_TAKE_W) ? pl_try_w(lock) :                             \
+                             (type == PL_TAKE_S) ? pl_try_s(lock) : pl_try_r(lock))
+
+	do {
+		unsigned char loops = m + 1;
+		m = (m << 1) + 1;
+		for (i = 0; i < nb; i++) {
+			if (__pl_take_one(locks[i]))
+				return i;
+		}
+		do {
+			pl_cpu_relax();
+		} while (__builtin_expect(--loops, 0));
+	} while (m != 255);
+
+	while (1) {
+		/* flag our presence on all locks, and try again those which
+		 * appear available.
+		 */
+		for (i = 0; i < nb; i++) {
+			curr = pl_ldor(locks[i], wbit);
+			if (!(curr & msk)) {
+				if (__pl_take_one(locks[i]))
+					return i;
+				curr = pl_deref_long(locks[i]) | wbit;
+			}
+			if (nb <= PL_FUTEX_WAITV_MAX) {
+				uaddr[i] = pl_futex_word(locks[i], wbit);
+				val[i] = (unsigned int)((curr | wbit) >> shift);
+			}
+		}
+
+		if (nb <= PL_FUTEX_WAITV_MAX) {
+			ret = pl_futex_waitv(uaddr, val, nb);
+			if (ret >= 0 && (unsigned long)ret < nb && __pl_take_one(locks[ret]))
+				return ret;
+		}
+		if (nb > PL_FUTEX_WAITV_MAX || (ret < 0 && errno == ENOSYS)) {
+#ifdef _POSIX_PRIORITY_SCHEDULING
+			sched_yield();
+#else
+			pl_cpu_relax();
+#endif
+		}
+	}
+#undef __pl_take_one
+}
+
+/* takes the R lock on whichever of the <nb> locks in <locks[]> becomes
+ * available first, and returns its index. See pl_take_any().
+ */
+#define pl_take_any_r(locks, nb, wbit) pl_take_any((locks), (nb), (wbit), PL_TAKE_R)
+
+/* takes the S lock on whichever of the <nb> locks in <locks[]> becomes
+ * available first, and returns its index. See pl_take_any().
+ */
+#define pl_take_any_s(locks, nb, wbit) pl_take_any((locks), (nb), (wbit), PL_TAKE_S)
+
+/* takes the W lock on whichever of the <nb> locks in <locks[]> becomes
+ * available first, and returns its index. See pl_take_any().
+ */
+#define pl_take_any_w(locks, nb, wbit) pl_take_any((locks), (nb), (wbit), PL_TAKE_W)
+
+/* Releases the lock bits <bits> from the unsigned long lock <lock>. If the
+ * waiter bit <wbit> was set, it is cleared and non-zero is returned to
+ * indicate that the waiters must be woken up on the lock's futex word.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static int pl_drop_flagged(unsigned long *lock, const unsigned long bits, const unsigned long wbit)
+{
+	unsigned long old;
+
+	pl_barrier();
+	/* S and W also release the exclusive part */
+	pl_tsan_release(lock, (bits & ((sizeof(long) == 8) ? (unsigned long)PLOCK64_SL_ANY :
+	                                (unsigned long)PLOCK32_SL_ANY)) ?
+	                PL_TSAN_EXC | PL_TSAN_SHR : PL_TSAN_SHR);
+	old = pl_ldsub_rel(lock, bits);
+	if (__builtin_expect(old & wbit, 0)) {
+		pl_and_noret(lock, ~wbit);
+		return 1;
+	}
+	return 0;
+}
+
+/* Releases the lock bits <bits> from the unsigned long lock <lock>, and if the
+ * waiter bit <wbit> was set, clears it and wakes up all threads sleeping in
+ * pl_take_any() on this lock. The cost is the same as a regular release when
+ * no waiter is present.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_drop_wake(unsigned long *lock, const unsigned long bits, const unsigned long wbit)
+{
+	if (pl_drop_flagged(lock, bits, wbit))
+		pl_futex_wake(pl_futex_word(lock, wbit), INT_MAX);
+}
+
+/* release the read access (R) lock and wake up pl_take_any() waiters */
+#define pl_drop_r_wake(lock, wbit)                                                             \
+	pl_drop_wake((lock), (sizeof(long) == 8) ? (unsigned long)PLOCK64_RL_1 :               \
+	             (unsigned long)PLOCK32_RL_1, (wbit))
+
+/* release the seek access (S) lock and wake up pl_take_any() waiters */
+#define pl_drop_s_wake(lock, wbit)                                                             \
+	pl_drop_wake((lock), (sizeof(long) == 8) ?                                             \
+	             (unsigned long)(PLOCK64_SL_1 | PLOCK64_RL_1) :                            \
+	             (unsigned long)(PLOCK32_SL_1 | PLOCK32_RL_1), (wbit))
+
+/* release the write (W) lock and wake up pl_take_any() waiters */
+#define pl_drop_w_wake(lock, wbit)                                                             \
+	pl_drop_wake((lock), (sizeof(long) == 8) ?                                             \
+	             (unsigned long)(PLOCK64_WL_1 | PLOCK64_SL_1 | PLOCK64_RL_1) :             \
+	             (unsigned long)(PLOCK32_WL_1 | PLOCK32_SL_1 | PLOCK32_RL_1), (wbit))
+
+/* Condition variables working with a plock held in R, S or W mode. The waiter
+ * records the sequence number, releases the lock, sleeps on the sequence
+ * number and takes the lock again in the same mode using pl_take_any(), so
+ * that no mutex is needed. The lock must be an unsigned long with a waiter
+ * bit <wbit> reserved as for pl_take_any(), and all its releases must be
+ * performed using pl_drop_{r,s,w}_wake(). pl_cond_signal() wakes up one
+ * waiter. pl_cond_broadcast() requeues all of them to a second futex word and
+ * wakes one of them only. Each waiter leaving pl_cond_wait() wakes the next
+ * requeued one once it got the lock, so that the waiters compete for the lock
+ * one or two at a time instead of all at once. As with pthread_cond_wait(),
+ * spurious wakeups are possible and the condition must be checked again.
+ */
+struct pl_cond {
+	unsigned int seq;     /* changed on each signal or broadcast */
+	unsigned int waiters; /* number of threads in pl_cond_wait() */
+	unsigned int queued;  /* requeued waiters left to wake, and their futex */
+};
+
+#define PL_COND_INITIALIZER { 0, 0, 0 }
+
+/* Wakes up the next waiter requeued on <cond> by pl_cond_broadcast(), if any.
+ * The counter is only decremented when non-zero since spurious wakeups may
+ * leave it above the number of sleepers, in which case the wakeup is lost but
+ * the thread which woke up spuriously also passes here.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_cond_chain(struct pl_cond *cond)
+{
+	unsigned int q = pl_load(&cond->queued);
+	unsigned int prev;
+
+	while (__builtin_expect(q != 0, 0)) {
+		prev = pl_cmpxchg(&cond->queued, q, q - 1);
+		if (prev == q) {
+			pl_futex_wake(&cond->queued, 1);
+			break;
+		}
+		q = prev;
+	}
+}
+
+/* Waits on condition <cond> with lock <lock> held in mode <type> (one of
+ * PL_TAKE_R, PL_TAKE_S or PL_TAKE_W). The lock is released and taken again in
+ * the same mode before returning.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_cond_wait(struct pl_cond *cond, unsigned long *lock, const unsigned long wbit, int type)
+{
+	unsigned int seq;
+
+	pl_inc_noret(&cond->waiters);
+	seq = pl_load(&cond->seq);
+
+	if (type == PL_TAKE_W)
+		pl_drop_w_wake(lock, wbit);
+	else if (type == PL_TAKE_S)
+		pl_drop_s_wake(lock, wbit);
+	else
+		pl_drop_r_wake(lock, wbit);
+
+	pl_futex_wait(&cond->seq, seq);
+	pl_dec_noret(&cond->waiters);
+	pl_take_any(&lock, 1, wbit, type);
+	pl_cond_chain(cond);
+}
+
+/* waits on <cond> with the R lock held on <lock>, see pl_cond_wait() */
+#define pl_cond_wait_r(cond, lock, wbit) pl_cond_wait((cond), (lock), (wbit), PL_TAKE_R)
+
+/* waits on <cond> with the S lock held on <lock>, see pl_cond_wait() */
+#define pl_cond_wait_s(cond, lock, wbit) pl_cond_wait((cond), (lock), (wbit), PL_TAKE_S)
+
+/* waits on <cond> with the W lock held on <lock>, see pl_cond_wait() */
+#define pl_cond_wait_w(cond, lock, wbit) pl_cond_wait((cond), (lock), (wbit), PL_TAKE_W)
+
+/* Wakes up one thread waiting on condition <cond>. This only costs an atomic
+ * increment when nobody waits. The lock does not need to be held.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_cond_signal(struct pl_cond *cond)
+{
+	pl_inc_noret(&cond->seq);
+	if (__builtin_expect(pl_load(&cond->waiters) != 0, 0))
+		pl_futex_wake(&cond->seq, 1);
+}
+
+/* Wakes up all threads waiting on condition <cond>. They are all requeued to
+ * the <queued> futex word, which is only incremented after the requeue so that
+ * none of them may be woken before being counted, then only the first one is
+ * woken up, and each of them wakes the next one once it got the lock. If the
+ * requeue fails (e.g. a concurrent signal changed the sequence), all waiters
+ * are woken up at once instead. The lock does not need to be held.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_cond_broadcast(struct pl_cond *cond)
+{
+	unsigned int seq = pl_ldadd(&cond->seq, 1) + 1;
+	long ret;
+
+	if (__builtin_expect(pl_load(&cond->waiters) == 0, 1))
+		return;
+
+	ret = pl_futex_requeue(&cond->seq, 0, &cond->queued, INT_MAX, seq);
+	if (ret < 0)
+		pl_futex_wake(&cond->seq, INT_MAX);
+	else if (ret > 0) {
+		pl_add_noret(&cond->queued, ret);
+		pl_cond_chain(cond);
+	}
+}
+
+/* Eventcounts allow consumers of lock-free structures to sleep when there is
+ * nothing to consume, without adding any lock to the producers. A consumer
+ * which finds the structure empty calls pl_ec_prepare_wait() to get a key,
+ * checks the structure again, then either calls pl_ec_cancel_wait() if it
+ * found something, or pl_ec_commit_wait() with the key to spin then sleep
+ * until a producer calls pl_ec_notify() after publishing. When nobody waits,
+ * the notification only costs a memory barrier and a load. If the producer
+ * published using an atomic read-modify-write operation, pl_ec_notify_ato()
+ * may be used instead, in which case the barrier is free on x86.
+ */
+struct pl_eventcount {
+	unsigned int epoch;   /* advanced by each notification with waiters */
+	unsigned int waiters; /* consumers between prepare and commit/cancel */
+};
+
+#define PL_EVENTCOUNT_INITIALIZER { 0, 0 }
+
+/* Registers the caller as a waiter on eventcount <ec> and returns the key to
+ * pass to pl_ec_commit_wait(). The caller must check its wake up condition
+ * again after this call, and call either pl_ec_cancel_wait() or
+ * pl_ec_commit_wait().
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static unsigned int pl_ec_prepare_wait(struct pl_eventcount *ec)
+{
+	pl_inc_noret(&ec->waiters);
+	return pl_load(&ec->epoch);
+}
+
+/* unregisters the caller as a waiter on eventcount <ec> */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_ec_cancel_wait(struct pl_eventcount *ec)
+{
+	pl_dec_noret(&ec->waiters);
+}
+
+/* Waits for eventcount <ec> to be notified after the caller got <key> from
+ * pl_ec_prepare_wait(). It spins with an exponential backoff of up to 255
+ * CPU pauses, then sleeps on the epoch. The caller is unregistered before
+ * returning. Spurious wakeups are possible.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_ec_commit_wait(struct pl_eventcount *ec, unsigned int key)
+{
+	unsigned char m = 0;
+
+	do {
+		unsigned char loops = m + 1;
+		m = (m << 1) + 1;
+		do {
+			pl_cpu_relax();
+		} while (__builtin_expect(--loops, 0));
+		if (pl_deref_int(&ec->epoch) != key)
+			goto out;
+	} while (m != 255);
+
+	while (pl_deref_int(&ec->epoch) == key)
+		pl_futex_wait(&ec->epoch, key);
+ out:
+	pl_dec_noret(&ec->waiters);
+}
+
+/* Wakes up to <nr> threads waiting on eventcount <ec> if any is registered.
+ * Must be preceded by a full barrier after the publication.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void __pl_ec_notify(struct pl_eventcount *ec, int nr)
+{
+	if (__builtin_expect(pl_load(&ec->waiters) != 0, 0)) {
+		pl_inc_noret(&ec->epoch);
+		pl_futex_wake(&ec->epoch, nr);
+	}
+}
+
+/* wakes up one waiter of <ec>, after a publication with a regular store */
+#define pl_ec_notify(ec)          do { pl_mb(); __pl_ec_notify((ec), 1); } while (0)
+
+/* wakes up all waiters of <ec>, after a publication with a regular store */
+#define pl_ec_notify_all(ec)      do { pl_mb(); __pl_ec_notify((ec), INT_MAX); } while (0)
+
+/* wakes up one waiter of <ec>, after a publication with an atomic operation */
+#define pl_ec_notify_ato(ec)      do { pl_mb_ato(); __pl_ec_notify((ec), 1); } while (0)
+
+/* wakes up all waiters of <ec>, after a publication with an atomic operation */
+#define pl_ec_notify_all_ato(ec)  do { pl_mb_ato(); __pl_ec_notify((ec), INT_MAX); } while (0)
+
+#endif /* PL_FUTEX_H */
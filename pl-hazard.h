@@ -0,0 +1,213 @@
+/* plock - hazard pointers
+ *
+ * Copyright (C) 2026 Willy Tarreau <w@1wt.eu>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PL_HAZARD_H
+#define PL_HAZARD_H
+
+/* The functions below implement hazard pointers, which allow readers of
+ * lock-free structures to protect the few nodes they are visiting from being
+ * freed, without bounding the memory retained by a stalled reader as epochs
+ * do. Each thread has PL_HP_SLOTS hazard slots on its own cache line(s), in
+ * which it publishes the pointers it is about to dereference. Removed nodes
+ * are retired into a per-thread list, and once this list reaches twice the
+ * total number of slots, it is scanned and the nodes which are not present in
+ * any slot are freed, so that the scan cost is amortized over many retires.
+ *
+ * Publishing a pointer requires a full barrier between the store to the slot
+ * and the verification that the pointer is still reachable. On Linux, the
+ * barrier may be moved to the scanning side using membarrier() (Linux 4.14+),
+ * which forces a full barrier on all running threads of the process, so that
+ * the protection only costs a compiler barrier. This is enabled by passing a
+ * non-zero <asym> to pl_hp_init(), and silently falls back to regular
+ * barriers when not supported.
+ */
+
+#include <stdlib.h>
+#include "plock.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#ifndef PL_HP_SLOTS
+#define PL_HP_SLOTS 2
+#endif
+
+/* membarrier commands from Linux 4.14, which are enums in the headers */
+#define PL_MEMBARRIER_CMD_PRIVATE_EXPEDITED           (1 << 3)
+#define PL_MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED  (1 << 4)
+
+/* the part to embed into retired objects, anywhere in them */
+struct pl_hp_node {
+	struct pl_hp_node *next;
+	void *obj;                               /* compared with the hazard slots */
+	void (*free)(struct pl_hp_node *node);   /* called once unreachable */
+};
+
+struct pl_hp_thread {
+	void *slot[PL_HP_SLOTS];            /* published hazard pointers */
+	struct pl_hp_node *retired;         /* nodes waiting for a scan */
+	unsigned int count;                 /* number of retired nodes */
+} __attribute__((aligned(64)));
+
+struct pl_hp {
+	unsigned int threads;               /* number of entries in <th> */
+	int asym;                           /* membarrier() is used */
+	struct pl_hp_thread *th;            /* one entry per thread */
+} __attribute__((aligned(64)));
+
+/* Initializes the hazard pointers domain <hp> for <threads> threads using the
+ * caller-allocated array <th> of <threads> entries. If <asym> is non-zero,
+ * the readers' barriers are replaced with membarrier() in the scans when the
+ * system supports it. Returns non-zero if asymmetric barriers are used.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static int pl_hp_init(struct pl_hp *hp, struct pl_hp_thread *th, unsigned int threads, int asym)
+{
+	unsigned int i, j;
+
+	hp->threads = threads;
+	hp->th = th;
+	hp->asym = 0;
+	for (i = 0; i < threads; i++) {
+		for (j = 0; j < PL_HP_SLOTS; j++)
+			th[i].slot[j] = NULL;
+		th[i].retired = NULL;
+		th[i].count = 0;
+	}
+#if defined(__linux__) && defined(SYS_membarrier)
+	if (asym && syscall(SYS_membarrier, PL_MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0)
+		hp->asym = 1;
+#else
+	(void)asym;
+#endif
+	pl_mb();
+	return hp->asym;
+}
+
+/* Protects the pointer stored at <src> using slot <idx> of thread <thr>, and
+ * returns it. The pointer may be dereferenced until the slot is cleared or
+ * reused. The pointer is loaded again after being published, and the
+ * operation is repeated if it changed, since it could have been retired
+ * before the publication was visible.
+ */
+#define pl_hp_protect(hp, thr, idx, src) ({                                                    \
+	struct pl_hp_thread *__th = &(hp)->th[thr];                                            \
+	typeof(*(src)) __p, __q = pl_load(src);                                                \
+	do {                                                                                   \
+		__p = __q;                                                                     \
+		pl_store(&__th->slot[idx], (void *)__p);                                       \
+		if ((hp)->asym)                                                                \
+			pl_barrier();                                                          \
+		else                                                                           \
+			pl_mb();                                                               \
+		__q = pl_load(src);                                                            \
+	} while (__builtin_expect(__q != __p, 0));                                             \
+	__p;                                                                                   \
+})
+
+/* clears slot <idx> of thread <thr>, after which the node it protected must
+ * not be accessed anymore.
+ */
+#define pl_hp_clear(hp, thr, idx) pl_store(&(hp)->th[thr].slot[idx], NULL)
+
+/* compares two pointers for qsort() and bsearch() */
+__attribute__((unused,no_instrument_function))
+static int pl_hp_cmp(const void *a, const void *b)
+{
+	unsigned long pa = (unsigned long)*(void * const *)a;
+	unsigned long pb = (unsigned long)*(void * const *)b;
+
+	return (pa > pb) - (pa < pb);
+}
+
+/* Scans the retired list of thread <thr> and frees the nodes which are not
+ * protected by any hazard slot. The hazard pointers are collected and sorted
+ * first, so that the cost is O(R*log(H)) for R retired nodes and H slots.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_hp_scan(struct pl_hp *hp, unsigned int thr)
+{
+	struct pl_hp_thread *th = &hp->th[thr];
+	void *haz[hp->threads * PL_HP_SLOTS];
+	struct pl_hp_node *list, *next;
+	unsigned int nb = 0, i, j;
+	void *p;
+
+	/* make sure any slot published before a node was unlinked is visible */
+#if defined(__linux__) && defined(SYS_membarrier)
+	if (hp->asym)
+		syscall(SYS_membarrier, PL_MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+	else
+#endif
+		pl_mb();
+
+	for (i = 0; i < hp->threads; i++) {
+		for (j = 0; j < PL_HP_SLOTS; j++) {
+			p = pl_load(&hp->th[i].slot[j]);
+			if (p)
+				haz[nb++] = p;
+		}
+	}
+	qsort(haz, nb, sizeof(*haz), pl_hp_cmp);
+
+	list = th->retired;
+	th->retired = NULL;
+	th->count = 0;
+	for (; list; list = next) {
+		next = list->next;
+		p = list->obj;
+		if (nb && bsearch(&p, haz, nb, sizeof(*haz), pl_hp_cmp)) {
+			list->next = th->retired;
+			th->retired = list;
+			th->count++;
+		}
+		else
+			list->free(list);
+	}
+}
+
+/* Retires object <obj> which was unlinked from a shared structure by thread
+ * <thr>, and which embeds node <node>. <obj> is the pointer the readers
+ * protect, which differs from <node> when the node is not the object's first
+ * member. The free callback <free> will be called with <node> once no hazard
+ * slot holds <obj> anymore. The retired list is scanned when it reaches twice
+ * the total number of slots.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_hp_retire(struct pl_hp *hp, unsigned int thr, void *obj, struct pl_hp_node *node, void (*free)(struct pl_hp_node *))
+{
+	struct pl_hp_thread *th = &hp->th[thr];
+
+	node->obj = obj;
+	node->free = free;
+	node->next = th->retired;
+	th->retired = node;
+	if (__builtin_expect(++th->count >= 2 * PL_HP_SLOTS * hp->threads, 0))
+		pl_hp_scan(hp, thr);
+}
+
+#endif /* PL_HAZARD_H */
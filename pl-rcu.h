@@ -0,0 +1,170 @@
+/* plock - RCU-style publication of read-mostly data
+ *
+ * Copyright (C) 2026 Willy Tarreau <w@1wt.eu>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PL_RCU_H
+#define PL_RCU_H
+
+/* The functions below allow read-mostly data to be replaced as a whole while
+ * readers access it using a single load, without any atomic operation nor
+ * lock. Writers which build the new version from the current one hold the
+ * domain's write lock from the moment they read the current version until
+ * they publish the new one using a release store, so that no update may be
+ * lost. They then release the lock and wait for a grace period before freeing
+ * the old version:
+ *
+ *     pl_rcu_write_lock(&rcu);
+ *     old = pl_rcu_deref(&ptr);
+ *     new = copy_and_modify(old);
+ *     pl_rcu_publish(&rcu, &ptr, new);
+ *     pl_rcu_write_unlock(&rcu);
+ *     pl_rcu_synchronize(&rcu);
+ *     free(old);
+ *
+ * Writers whose new version does not depend on the current one may simply use
+ * pl_rcu_replace() which does not need the lock.
+ *
+ * Grace periods are detected using quiescent states (QSBR): each registered
+ * reader thread regularly calls pl_rcu_quiescent() at a point where it does
+ * not hold any reference to protected data (e.g. between two events), which
+ * copies the global grace period counter into its own slot using a plain
+ * store. pl_rcu_synchronize() advances the counter and waits for all online
+ * threads to have copied it, which proves they dropped all references they
+ * had before. Threads which may stay idle for a long time should go offline
+ * using pl_rcu_offline() so that they do not delay the writers, and come back
+ * with pl_rcu_online() before accessing protected data again.
+ */
+
+#include "plock.h"
+
+struct pl_rcu_thread {
+	unsigned long qs;                   /* last grace period seen, 0=offline */
+} __attribute__((aligned(64)));
+
+struct pl_rcu {
+	unsigned long gp;                   /* grace period counter, never 0 */
+	unsigned long lock;                 /* serializes the writers */
+	unsigned int threads;               /* number of entries in <th> */
+	struct pl_rcu_thread *th;           /* one entry per reader thread */
+} __attribute__((aligned(64)));
+
+/* Initializes RCU domain <rcu> for <threads> threads using the caller-
+ * allocated array <th> of <threads> entries. All threads start offline.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_rcu_init(struct pl_rcu *rcu, struct pl_rcu_thread *th, unsigned int threads)
+{
+	unsigned int i;
+
+	rcu->gp = 1;
+	rcu->lock = 0;
+	rcu->threads = threads;
+	rcu->th = th;
+	for (i = 0; i < threads; i++)
+		th[i].qs = 0;
+}
+
+/* Reports a quiescent state for thread <thr>: no reference to protected data
+ * obtained before this call will be used after it. The counter is read with
+ * acquire semantics so that the subsequent loads of protected pointers cannot
+ * return values older than the announced grace period.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_rcu_quiescent(struct pl_rcu *rcu, unsigned int thr)
+{
+	pl_store(&rcu->th[thr].qs, pl_load(&rcu->gp));
+}
+
+/* Marks thread <thr> online. It may access protected data afterwards. */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_rcu_online(struct pl_rcu *rcu, unsigned int thr)
+{
+	pl_store(&rcu->th[thr].qs, pl_load(&rcu->gp));
+	pl_mb();
+}
+
+/* Marks thread <thr> offline. It must not hold any reference to protected
+ * data anymore, and writers will not wait for it.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_rcu_offline(struct pl_rcu *rcu, unsigned int thr)
+{
+	pl_store(&rcu->th[thr].qs, 0);
+}
+
+/* returns the protected pointer stored at <ptr>, which remains valid until the
+ * next quiescent state of the calling thread.
+ */
+#define pl_rcu_deref(ptr) pl_load(ptr)
+
+/* Waits for a grace period to elapse in domain <rcu>, that is, for all online
+ * threads to report a quiescent state. The calling thread must not be online
+ * in <rcu>, otherwise it would wait for itself. The wait uses the exponential
+ * backoff of pl_wait_new_long().
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_rcu_synchronize(struct pl_rcu *rcu)
+{
+	unsigned long target = pl_ldadd(&rcu->gp, 1) + 1;
+	unsigned long qs;
+	unsigned int i;
+
+	for (i = 0; i < rcu->threads; i++) {
+		qs = pl_load(&rcu->th[i].qs);
+		while (qs && (long)(qs - target) < 0)
+			qs = pl_wait_new_long(&rcu->th[i].qs, qs);
+	}
+	pl_mb();
+}
+
+/* takes the write lock of domain <rcu>, which serializes the writers */
+#define pl_rcu_write_lock(rcu) pl_take_w(&(rcu)->lock)
+
+/* releases the write lock of domain <rcu> */
+#define pl_rcu_write_unlock(rcu) pl_drop_w(&(rcu)->lock)
+
+/* Publishes pointer <new> at <ptr> in domain <rcu> using a release store, and
+ * returns the previous one, which must not be released before
+ * pl_rcu_synchronize() returns. The caller must hold the domain's write lock
+ * since it read the version <new> was built from.
+ */
+#define pl_rcu_publish(rcu, ptr, new) ({                                                       \
+	typeof(*(ptr)) __old = *(ptr);                                                         \
+	pl_mb_store();                                                                         \
+	pl_store((ptr), (new));                                                                \
+	__old;                                                                                 \
+})
+
+/* Publishes pointer <new> at <ptr> in domain <rcu> regardless of the previous
+ * one, waits for a grace period and returns the previous pointer which may
+ * then be released. The write lock is not needed, but the new version must not
+ * be built from the previous one, otherwise concurrent updates may be lost.
+ */
+#define pl_rcu_replace(rcu, ptr, new) ({                                                       \
+	typeof(*(ptr)) __prev = pl_xchg((ptr), (new));                                         \
+	pl_rcu_synchronize(rcu);                                                               \
+	__prev;                                                                                \
+})
+
+#endif /* PL_RCU_H */
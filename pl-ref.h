@@ -0,0 +1,203 @@
+/* plock - distributed reference counts
+ *
+ * Copyright (C) 2026 Willy Tarreau <w@1wt.eu>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PL_REF_H
+#define PL_REF_H
+
+/* The functions below implement reference counts for hot shared objects,
+ * whose gets and puts only touch a per-thread slot while the object is live,
+ * so that they do not bounce a shared cache line between all CPUs. Since the
+ * sum of all slots cannot be known exactly at any time, the count cannot
+ * reach zero while the object is live. Once the owner decides to release the
+ * object, it calls pl_ref_kill() which switches the counter to a single atomic
+ * word holding the sum of all slots, and drops the initial reference. From
+ * this point, gets and puts are regular atomic operations on this word, and
+ * the last put is reported.
+ *
+ * In order to switch mode safely, each thread flags its slot as busy before
+ * checking the mode, and the killer waits for each slot not to be busy after
+ * changing the mode. This requires a full barrier on both sides. On Linux the
+ * threads' barrier may be replaced with a compiler barrier by having the
+ * killer use membarrier() (Linux 4.14+), which is requested by passing a
+ * non-zero <asym> to pl_ref_init() and silently falls back to regular
+ * barriers when not supported. In this case the fast path only consists in
+ * three plain stores and two loads.
+ */
+
+#include "plock.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+/* membarrier commands from Linux 4.14, which are enums in the headers */
+#ifndef PL_MEMBARRIER_CMD_PRIVATE_EXPEDITED
+#define PL_MEMBARRIER_CMD_PRIVATE_EXPEDITED           (1 << 3)
+#define PL_MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED  (1 << 4)
+#endif
+
+/* added to the atomic count while switching modes */
+#define PL_REF_BIAS (1L << (sizeof(long) * 8 - 2))
+
+struct pl_ref_slot {
+	long count;                 /* gets minus puts performed by this thread */
+	unsigned int busy;          /* non-zero while updating in live mode */
+} __attribute__((aligned(64)));
+
+struct pl_ref {
+	long count;                 /* the count in atomic mode, initial ref otherwise */
+	unsigned int live;          /* non-zero while per-thread slots are used */
+	int asym;                   /* membarrier() is used */
+	unsigned int threads;       /* number of entries in <slots> */
+	struct pl_ref_slot *slots;  /* one entry per thread */
+} __attribute__((aligned(64)));
+
+/* Initializes reference count <ref> in live mode with one initial reference,
+ * for <threads> threads using the caller-allocated array <slots> of <threads>
+ * entries. If <asym> is non-zero, membarrier() is used by pl_ref_kill() when
+ * the system supports it. Returns non-zero if asymmetric barriers are used.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static int pl_ref_init(struct pl_ref *ref, struct pl_ref_slot *slots, unsigned int threads, int asym)
+{
+	unsigned int i;
+
+	ref->count = 1;
+	ref->live = 1;
+	ref->asym = 0;
+	ref->threads = threads;
+	ref->slots = slots;
+	for (i = 0; i < threads; i++) {
+		slots[i].count = 0;
+		slots[i].busy = 0;
+	}
+#if defined(__linux__) && defined(SYS_membarrier)
+	if (asym && syscall(SYS_membarrier, PL_MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0)
+		ref->asym = 1;
+#else
+	(void)asym;
+#endif
+	pl_mb();
+	return ref->asym;
+}
+
+/* Adds <v> to the slot of thread <thr> of reference count <ref> if it is
+ * still live, and returns non-zero, otherwise returns zero.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static int pl_ref_add_live(struct pl_ref *ref, unsigned int thr, long v)
+{
+	struct pl_ref_slot *slot = &ref->slots[thr];
+	int ret = 0;
+
+	pl_store(&slot->busy, 1);
+	if (ref->asym)
+		pl_barrier();
+	else
+		pl_mb();
+	if (__builtin_expect(pl_load(&ref->live), 1)) {
+		pl_store(&slot->count, slot->count + v);
+		ret = 1;
+	}
+	pl_store(&slot->busy, 0);
+	return ret;
+}
+
+/* takes a reference on <ref> for thread <thr> */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_ref_inc(struct pl_ref *ref, unsigned int thr)
+{
+	if (!pl_ref_add_live(ref, thr, 1))
+		pl_inc_noret(&ref->count);
+}
+
+/* Drops a reference on <ref> for thread <thr>. Returns non-zero if it was the
+ * last one, which is only possible after pl_ref_kill().
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static int pl_ref_dec(struct pl_ref *ref, unsigned int thr)
+{
+	if (pl_ref_add_live(ref, thr, -1))
+		return 0;
+	return !pl_dec(&ref->count);
+}
+
+/* Returns an approximate value of the count of <ref>, which is exact once
+ * killed.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static long pl_ref_read(const struct pl_ref *ref)
+{
+	long sum = pl_load(&ref->count);
+	unsigned int i;
+
+	if (pl_load(&ref->live)) {
+		for (i = 0; i < ref->threads; i++)
+			sum += pl_load(&ref->slots[i].count);
+	}
+	return sum;
+}
+
+/* Switches reference count <ref> to atomic mode, then drops the initial
+ * reference. Returns non-zero if it was the last one. Must only be called
+ * once.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static int pl_ref_kill(struct pl_ref *ref)
+{
+	struct pl_ref_slot *slot;
+	unsigned int i;
+	long sum = 0;
+
+	/* puts performed in atomic mode before the sum is added must not
+	 * reach zero, so a bias is added first.
+	 */
+	pl_add_noret(&ref->count, PL_REF_BIAS);
+	pl_store(&ref->live, 0);
+
+	/* make sure that any thread which did not see the change has its busy
+	 * flag visible.
+	 */
+#if defined(__linux__) && defined(SYS_membarrier)
+	if (ref->asym)
+		syscall(SYS_membarrier, PL_MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+	else
+#endif
+		pl_mb();
+
+	for (i = 0; i < ref->threads; i++) {
+		slot = &ref->slots[i];
+		while (pl_load(&slot->busy))
+			pl_cpu_relax();
+		sum += pl_load(&slot->count);
+	}
+
+	/* the bias and the initial reference are replaced with the sum */
+	sum -= PL_REF_BIAS + 1;
+	return pl_ldadd(&ref->count, sum) + sum == 0;
+}
+
+#endif /* PL_REF_H */
@@ -0,0 +1,138 @@
+/* plock - counting semaphores
+ *
+ * Copyright (C) 2026 Willy Tarreau <w@1wt.eu>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PL_SEM_H
+#define PL_SEM_H
+
+/* The functions below implement a counting semaphore using the same
+ * techniques as the locks: the permits are taken using a single atomic
+ * subtract when available, which is rolled back on failure. The waiter then
+ * watches the counter with an exponential backoff of up to 255 CPU pauses
+ * before registering itself and sleeping on the counter's futex. Releases are
+ * a single atomic add, followed by a FUTEX_WAKE only when some waiters were
+ * registered. Any number of permits may be taken and released at once.
+ *
+ * The counter is signed, since it may transiently go below zero when threads
+ * race for the last permits. On non-Linux systems, the sleep is replaced with
+ * sched_yield() as for pl_sleep_new_int().
+ */
+
+#include "pl-futex.h"
+
+struct pl_sem {
+	int avail;             /* available permits, may transiently be negative */
+	unsigned int waiters;  /* number of sleeping threads */
+};
+
+#define PL_SEM_INITIALIZER(n) { (n), 0 }
+
+/* initializes semaphore <sem> with <n> permits */
+#define pl_sem_init(sem, n) do { (sem)->avail = (n); (sem)->waiters = 0; } while (0)
+
+/* returns the number of available permits, which may be negative */
+#define pl_sem_avail(sem) ((int)pl_deref_int((unsigned int *)&(sem)->avail))
+
+/* Releases <k> permits to semaphore <sem>, and wakes up sleeping threads if
+ * any. All of them are woken up, since they may be waiting for different
+ * numbers of permits.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_sem_drop_k(struct pl_sem *sem, int k)
+{
+	pl_add_noret(&sem->avail, k);
+	if (__builtin_expect(pl_load(&sem->waiters) != 0, 0))
+		pl_futex_wake((unsigned int *)&sem->avail, INT_MAX);
+}
+
+/* Tries to take <k> permits from semaphore <sem>. Returns non-zero on
+ * success, otherwise zero. No atomic operation is performed if the permits do
+ * not look available.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static int pl_sem_try_k(struct pl_sem *sem, int k)
+{
+	if (pl_sem_avail(sem) < k)
+		return 0;
+	if (__builtin_expect(pl_ldsub_acq(&sem->avail, k) >= k, 1))
+		return 1;
+	/* lost the race, another thread may be waiting for our rollback */
+	pl_sem_drop_k(sem, k);
+	return 0;
+}
+
+/* Takes <k> permits from semaphore <sem>, waiting as long as needed. The
+ * waiter spins with an exponential backoff then sleeps on the counter.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_sem_wait_k(struct pl_sem *sem, int k)
+{
+	unsigned char m = 0;
+	int curr;
+
+	while (1) {
+		do {
+			unsigned char loops = m + 1;
+			m = (m << 1) + 1;
+			do {
+				pl_cpu_relax();
+			} while (__builtin_expect(--loops, 0));
+			if (pl_sem_try_k(sem, k))
+				return;
+		} while (m != 255);
+
+		/* register before checking the counter so that a release
+		 * either sees us or changes the value we sleep on.
+		 */
+		pl_inc_noret(&sem->waiters);
+		curr = pl_sem_avail(sem);
+		if (curr < k)
+			pl_futex_wait((unsigned int *)&sem->avail, curr);
+		pl_dec_noret(&sem->waiters);
+		if (pl_sem_try_k(sem, k))
+			return;
+		m = 0;
+	}
+}
+
+/* Takes <k> permits from semaphore <sem>. The fast path is inlined. */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_sem_take_k(struct pl_sem *sem, int k)
+{
+	if (__builtin_expect(pl_ldsub_acq(&sem->avail, k) >= k, 1))
+		return;
+	pl_sem_drop_k(sem, k);
+	pl_sem_wait_k(sem, k);
+}
+
+/* takes one permit from <sem> */
+#define pl_sem_take(sem) pl_sem_take_k((sem), 1)
+
+/* tries to take one permit from <sem>, returns non-zero on success */
+#define pl_sem_try(sem) pl_sem_try_k((sem), 1)
+
+/* releases one permit to <sem> */
+#define pl_sem_drop(sem) pl_sem_drop_k((sem), 1)
+
+#endif /* PL_SEM_H */
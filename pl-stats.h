@@ -0,0 +1,223 @@
+/* plock - sharded statistics counters
+ *
+ * Copyright (C) 2026 Willy Tarreau <w@1wt.eu>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PL_STATS_H
+#define PL_STATS_H
+
+/* The functions below implement sets of statistics counters which are
+ * updated very often and read rarely. Each thread owns a shard made of one
+ * cache line aligned copy of all counters of the set, that it updates using
+ * plain stores without any atomic operation, so that counters never bounce
+ * between CPUs. Readers aggregate all shards on demand. Each counter is of
+ * one kind : a sum (PL_STATS_SUM), a maximum (PL_STATS_MAX) or a minimum
+ * (PL_STATS_MIN), which is the operation used to aggregate it.
+ *
+ * A thread may optionally fold its shard into an extra shared shard, e.g.
+ * periodically or before it stops using the set, which resets its own shard.
+ * This shared shard is only updated with atomic operations. Each shard carries
+ * a sequence number which is odd during a fold, so that readers can retry
+ * when they raced with a fold instead of counting a value twice or missing
+ * it.
+ *
+ * The storage is allocated by the caller as an array of unsigned longs of
+ * PL_STATS_AREA_LONGS(threads, counters) entries, aligned to 64 bytes.
+ */
+
+#include "plock.h"
+
+/* counter kinds */
+#define PL_STATS_SUM 0
+#define PL_STATS_MAX 1
+#define PL_STATS_MIN 2
+
+/* number of longs of one shard holding <counters> counters and the sequence
+ * number, rounded up to a multiple of 64 bytes.
+ */
+#define PL_STATS_SHARD_LONGS(counters)                                         \
+	((((counters) + 1) * sizeof(long) + 63) / 64 * (64 / sizeof(long)))
+
+/* number of longs of the storage area for <threads> threads, including the
+ * shared shard used to fold.
+ */
+#define PL_STATS_AREA_LONGS(threads, counters)                                 \
+	(((threads) + 1) * PL_STATS_SHARD_LONGS(counters))
+
+struct pl_stats {
+	unsigned int counters;      /* number of counters in the set */
+	unsigned int threads;       /* number of thread shards */
+	unsigned long stride;       /* longs per shard */
+	const unsigned char *kinds; /* <counters> PL_STATS_* entries, NULL for all sums */
+	unsigned long *area;        /* <threads> shards, then the folded one */
+};
+
+/* returns the shard of thread <thr> (or the folded one for <threads>) */
+#define pl_stats_shard(st, thr) ((st)->area + (unsigned long)(thr) * (st)->stride)
+
+/* returns the kind of counter <idx> of set <st> */
+#define pl_stats_kind(st, idx) ((st)->kinds ? (st)->kinds[idx] : PL_STATS_SUM)
+
+/* returns the neutral value of counters of kind <kind> */
+#define pl_stats_neutral(kind) ((kind) == PL_STATS_MIN ? ~0UL : 0UL)
+
+/* Initializes counter set <st> of <counters> counters for <threads> threads,
+ * using the caller-allocated <area> of PL_STATS_AREA_LONGS(threads, counters)
+ * longs. <kinds> is either NULL if all counters are sums, or an array of
+ * <counters> PL_STATS_* values, which must remain valid.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_stats_init(struct pl_stats *st, unsigned long *area, unsigned int threads,
+			  unsigned int counters, const unsigned char *kinds)
+{
+	unsigned long *shard;
+	unsigned int t, i;
+
+	st->counters = counters;
+	st->threads = threads;
+	st->stride = PL_STATS_SHARD_LONGS(counters);
+	st->kinds = kinds;
+	st->area = area;
+	for (t = 0; t <= threads; t++) {
+		shard = pl_stats_shard(st, t);
+		shard[0] = 0;
+		for (i = 0; i < counters; i++)
+			shard[1 + i] = pl_stats_neutral(pl_stats_kind(st, i));
+	}
+	pl_mb();
+}
+
+/* adds <v> to sum counter <idx> of set <st> for thread <thr> */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_stats_add(struct pl_stats *st, unsigned int thr, unsigned int idx, unsigned long v)
+{
+	unsigned long *ctr = pl_stats_shard(st, thr) + 1 + idx;
+
+	pl_store(ctr, *ctr + v);
+}
+
+/* raises max counter <idx> of set <st> for thread <thr> to <v> if lower */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_stats_max(struct pl_stats *st, unsigned int thr, unsigned int idx, unsigned long v)
+{
+	unsigned long *ctr = pl_stats_shard(st, thr) + 1 + idx;
+
+	if (v > *ctr)
+		pl_store(ctr, v);
+}
+
+/* lowers min counter <idx> of set <st> for thread <thr> to <v> if higher */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_stats_min(struct pl_stats *st, unsigned int thr, unsigned int idx, unsigned long v)
+{
+	unsigned long *ctr = pl_stats_shard(st, thr) + 1 + idx;
+
+	if (v < *ctr)
+		pl_store(ctr, v);
+}
+
+/* returns <a> and <b> aggregated according to <kind> */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static unsigned long pl_stats_merge(unsigned int kind, unsigned long a, unsigned long b)
+{
+	if (kind == PL_STATS_MAX)
+		return a > b ? a : b;
+	if (kind == PL_STATS_MIN)
+		return a < b ? a : b;
+	return a + b;
+}
+
+/* Folds the shard of thread <thr> into the shared shard of set <st>, and
+ * resets it. Must only be called by the thread owning the shard.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static void pl_stats_fold(struct pl_stats *st, unsigned int thr)
+{
+	unsigned long *shard = pl_stats_shard(st, thr);
+	unsigned long *folded = pl_stats_shard(st, st->threads);
+	unsigned long v, old, upd, prev;
+	unsigned int i, kind;
+
+	pl_store(&shard[0], shard[0] + 1);
+	pl_mb_store();
+	for (i = 0; i < st->counters; i++) {
+		kind = pl_stats_kind(st, i);
+		v = shard[1 + i];
+		if (v == pl_stats_neutral(kind))
+			continue;
+		if (kind == PL_STATS_SUM)
+			pl_add_noret(&folded[1 + i], v);
+		else {
+			old = pl_load(&folded[1 + i]);
+			while ((upd = pl_stats_merge(kind, old, v)) != old &&
+			       (prev = pl_cmpxchg(&folded[1 + i], old, upd)) != old)
+				old = prev;
+		}
+		pl_store(&shard[1 + i], pl_stats_neutral(kind));
+	}
+	pl_mb_store();
+	pl_store(&shard[0], shard[0] + 1);
+}
+
+/* returns the sum of the sequence numbers of all shards of set <st>, or ~0 if
+ * any of them is being folded.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static unsigned long pl_stats_seq(const struct pl_stats *st)
+{
+	unsigned long seq, sum = 0;
+	unsigned int t;
+
+	for (t = 0; t < st->threads; t++) {
+		seq = pl_load(pl_stats_shard(st, t));
+		if (seq & 1)
+			return ~0UL;
+		sum += seq;
+	}
+	return sum;
+}
+
+/* Returns the value of counter <idx> of set <st>, aggregated over all shards.
+ * It is a snapshot which does not count any update twice even when racing
+ * with folds.
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static unsigned long pl_stats_read(const struct pl_stats *st, unsigned int idx)
+{
+	unsigned int kind = pl_stats_kind(st, idx);
+	unsigned long seq, ret;
+	unsigned int t;
+
+	do {
+		while ((seq = pl_stats_seq(st)) == ~0UL)
+			pl_cpu_relax();
+		pl_mb_load();
+		ret = pl_load(pl_stats_shard(st, st->threads) + 1 + idx);
+		for (t = 0; t < st->threads; t++)
+			ret = pl_stats_merge(kind, ret, pl_load(pl_stats_shard(st, t) + 1 + idx));
+		pl_mb_load();
+	} while (pl_stats_seq(st) != seq);
+	return ret;
+}
+
+#endif /* PL_STATS_H */
@@ -0,0 +1,161 @@
+/* plock - io_uring-based lock waits
+ *
+ * Copyright (C) 2026 Willy Tarreau <w@1wt.eu>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PL_URING_H
+#define PL_URING_H
+
+/* The functions below allow event-driven threads using io_uring to wait for
+ * a lock without ever blocking in a syscall. When a lock cannot be taken, the
+ * thread flags its presence in the lock using the waiter bit as done by
+ * pl_take_any(), and submits an IORING_OP_FUTEX_WAIT request (Linux 6.7+) on
+ * the lock's futex word. The completion is delivered as a regular CQE, upon
+ * which the thread tries again. The release path is the same as the one used
+ * by pl_take_any(), so that all these waiters may be mixed on the same locks:
+ * either pl_drop_{r,s,w}_wake() which performs the FUTEX_WAKE syscall, or
+ * pl_uring_drop_{r,s,w}() followed by an IORING_OP_FUTEX_WAKE request prepared
+ * with pl_uring_prep_wake() when it returns non-zero.
+ *
+ * The functions only prepare SQEs, the ring itself is managed by the caller
+ * (e.g. using liburing), which only needs the kernel's <linux/io_uring.h>.
+ */
+
+#include <string.h>
+#include <linux/io_uring.h>
+#include "pl-futex.h"
+
+/* opcodes and flags from Linux 6.7, which may be missing from older headers
+ * (the opcodes are enums there, hence the different names).
+ */
+#define PL_IORING_OP_FUTEX_WAIT  51
+#define PL_IORING_OP_FUTEX_WAKE  52
+
+#ifndef FUTEX2_SIZE_U32
+#define FUTEX2_SIZE_U32          0x02
+#endif
+
+#ifndef FUTEX2_PRIVATE
+#define FUTEX2_PRIVATE           FUTEX_PRIVATE_FLAG
+#endif
+
+/* Tries to take the lock of type <type> (PL_TAKE_R, PL_TAKE_S or PL_TAKE_W)
+ * on <lock>. Returns non-zero on success. Otherwise the waiter bit <wbit> is
+ * set in the lock, <val> is set to the futex value to wait for, and zero is
+ * returned. The caller then has to prepare a wait using pl_uring_prep_wait()
+ * and to call this function again once the CQE is received, regardless of
+ * the result (which may be -EAGAIN if the lock changed in between).
+ */
+__attribute__((unused,noinline,no_instrument_function))
+static int pl_uring_take(unsigned long *lock, const unsigned long wbit, int type, unsigned int *val)
+{
+	const unsigned long wmsk = (sizeof(long) == 8) ? (unsigned long)PLOCK64_WL_ANY : (unsigned long)PLOCK32_WL_ANY;
+	const unsigned long smsk = (sizeof(long) == 8) ? (unsigned long)PLOCK64_SL_ANY : (unsigned long)PLOCK32_SL_ANY;
+	const unsigned long msk = (type == PL_TAKE_R) ? wmsk : wmsk | smsk;
+	unsigned long curr;
+
+#define __pl_take_one(lock) ((type == PL_TAKE_W) ? pl_try_w(lock) :                             \
+                             (type == PL_TAKE_S) ? pl_try_s(lock) : pl_try_r(lock))
+
+	if (__pl_take_one(lock))
+		return 1;
+
+	curr = pl_ldor(lock, wbit);
+	if (!(curr & msk)) {
+		if (__pl_take_one(lock))
+			return 1;
+		curr = pl_deref_long(lock);
+	}
+	*val = (unsigned int)((curr | wbit) >> pl_futex_shift(wbit));
+	return 0;
+#undef __pl_take_one
+}
+
+/* tries to take the R lock on <lock>, see pl_uring_take() */
+#define pl_uring_take_r(lock, wbit, val) pl_uring_take((lock), (wbit), PL_TAKE_R, (val))
+
+/* tries to take the S lock on <lock>, see pl_uring_take() */
+#define pl_uring_take_s(lock, wbit, val) pl_uring_take((lock), (wbit), PL_TAKE_S, (val))
+
+/* tries to take the W lock on <lock>, see pl_uring_take() */
+#define pl_uring_take_w(lock, wbit, val) pl_uring_take((lock), (wbit), PL_TAKE_W, (val))
+
+/* Prepares <sqe> to wait on <lock> for a change of the futex value <val> that
+ * was returned by pl_uring_take() for waiter bit <wbit>. <data> is placed in
+ * the CQE's user_data.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_uring_prep_wait(struct io_uring_sqe *sqe, unsigned long *lock, const unsigned long wbit,
+                               unsigned int val, unsigned long long data)
+{
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = PL_IORING_OP_FUTEX_WAIT;
+	sqe->fd = FUTEX2_SIZE_U32 | FUTEX2_PRIVATE;
+	sqe->addr = (unsigned long)pl_futex_word(lock, wbit);
+	sqe->addr2 = val;
+	sqe->addr3 = FUTEX_BITSET_MATCH_ANY;
+	sqe->user_data = data;
+}
+
+/* Prepares <sqe> to wake up all waiters on <lock> for waiter bit <wbit>, as
+ * indicated by pl_uring_drop_{r,s,w}(). <data> is placed in the CQE's
+ * user_data.
+ */
+__attribute__((unused,always_inline,no_instrument_function)) inline
+static void pl_uring_prep_wake(struct io_uring_sqe *sqe, unsigned long *lock, const unsigned long wbit,
+                               unsigned long long data)
+{
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = PL_IORING_OP_FUTEX_WAKE;
+	sqe->fd = FUTEX2_SIZE_U32 | FUTEX2_PRIVATE;
+	sqe->addr = (unsigned long)pl_futex_word(lock, wbit);
+	sqe->addr2 = INT_MAX;
+	sqe->addr3 = FUTEX_BITSET_MATCH_ANY;
+	sqe->user_data = data;
+}
+
+/* release the read access (R) lock, return non-zero if waiters must be woken up
+ * using pl_uring_prep_wake() or pl_futex_wake(). See pl_drop_flagged().
+ */
+#define pl_uring_drop_r(lock, wbit)                                                            \
+	pl_drop_flagged((lock), (sizeof(long) == 8) ?                                          \
+	                (unsigned long)(PLOCK64_RL_1) :                                        \
+	                (unsigned long)(PLOCK32_RL_1), (wbit))
+
+/* release the seek access (S) lock, return non-zero if waiters must be woken up
+ * using pl_uring_prep_wake() or pl_futex_wake(). See pl_drop_flagged().
+ */
+#define pl_uring_drop_s(lock, wbit)                                                            \
+	pl_drop_flagged((lock), (sizeof(long) == 8) ?                                          \
+	                (unsigned long)(PLOCK64_SL_1 | PLOCK64_RL_1) :                         \
+	                (unsigned long)(PLOCK32_SL_1 | PLOCK32_RL_1), (wbit))
+
+/* release the write (W) lock, return non-zero if waiters must be woken up
+ * using pl_uring_prep_wake() or pl_futex_wake(). See pl_drop_flagged().
+ */
+#define pl_uring_drop_w(lock, wbit)                                                            \
+	pl_drop_flagged((lock), (sizeof(long) == 8) ?                                          \
+	                (unsigned long)(PLOCK64_WL_1 | PLOCK64_SL_1 | PLOCK64_RL_1) :          \
+	                (unsigned long)(PLOCK32_WL_1 | PLOCK32_SL_1 | PLOCK32_RL_1), (wbit))
+
+#endif /* PL_URING_H */
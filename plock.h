@@ -31,6 +31,68 @@
 #include <sched.h>
 #endif
 
+/* ThreadSanitizer cannot follow the ordering provided by the lock word when
+ * it's manipulated using inline asm, nor the cases where a lock is granted
+ * after spinning on plain loads (e.g. W waiting for readers to leave). When
+ * built with -fsanitize=thread, each transition is thus annotated with
+ * __tsan_release() before leaving a state and __tsan_acquire() once a state
+ * is granted. Three sync objects are used per lock, placed on the lock's
+ * extra bytes so that they don't need any storage and never collide with
+ * the lock word itself:
+ *   - SHR is released by any thread leaving a state counted in R (R, S, W,
+ *     J, C, including R->J/C/A and C->A), and acquired by those which waited
+ *     for readers to leave (W, A, exclusive J, and the same transitions) ;
+ *   - EXC is released when leaving S or W, and acquired when entering any
+ *     state ;
+ *   - ATO is released when leaving a multiple writers state (A, J, C), and
+ *     acquired when entering R, S, W or an exclusive J, as well as by A->R
+ *     and by the last writer. It is not acquired by A so that concurrent A holders
+ *     remain unordered and races between them are still detected.
+ * The lock word is also read using relaxed atomic loads in this case, so that
+ * these reads are not reported as racing with the atomic operations. None of
+ * this exists outside of TSan builds. PLOCK_TSAN may also be defined to force
+ * it with compilers that don't advertise the sanitizer.
+ */
+#if !defined(PLOCK_TSAN)
+#if defined(__SANITIZE_THREAD__)
+#define PLOCK_TSAN
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define PLOCK_TSAN
+#endif
+#endif
+#endif
+
+#define PL_TSAN_SHR 1
+#define PL_TSAN_EXC 2
+#define PL_TSAN_ATO 4
+
+#if defined(PLOCK_TSAN)
+#ifdef __cplusplus
+extern "C" {
+#endif
+void __tsan_acquire(void *addr);
+void __tsan_release(void *addr);
+#ifdef __cplusplus
+}
+#endif
+
+#define pl_tsan_acquire(lock, how) do {                                                        \
+		if ((how) & PL_TSAN_SHR) __tsan_acquire((char *)(lock) + 1);                   \
+		if ((how) & PL_TSAN_EXC) __tsan_acquire((char *)(lock) + 2);                   \
+		if ((how) & PL_TSAN_ATO) __tsan_acquire((char *)(lock) + 3);                   \
+	} while (0)
+
+#define pl_tsan_release(lock, how) do {                                                        \
+		if ((how) & PL_TSAN_SHR) __tsan_release((char *)(lock) + 1);                   \
+		if ((how) & PL_TSAN_EXC) __tsan_release((char *)(lock) + 2);                   \
+		if ((how) & PL_TSAN_ATO) __tsan_release((char *)(lock) + 3);                   \
+	} while (0)
+#else
+#define pl_tsan_acquire(lock, how) do { } while (0)
+#define pl_tsan_release(lock, how) do { } while (0)
+#endif
+
 /* 64 bit */
 #define PLOCK64_RL_1   0x0000000000000004ULL
 #define PLOCK64_RL_2PL 0x00000000FFFFFFF8ULL
@@ -52,10 +114,18 @@
 #define PLOCK32_WL_ANY 0xFFFC0000
 
 /* dereferences <*p> as unsigned long without causing aliasing issues */
+#if defined(PLOCK_USE_STDATOMIC) || defined(PLOCK_TSAN)
+#define pl_deref_long(p) __atomic_load_n((unsigned long *)(p), __ATOMIC_RELAXED)
+#else
 #define pl_deref_long(p) ({ volatile unsigned long *__pl_l = (unsigned long *)(p); *__pl_l; })
+#endif
 
 /* dereferences <*p> as unsigned int without causing aliasing issues */
+#if defined(PLOCK_USE_STDATOMIC) || defined(PLOCK_TSAN)
+#define pl_deref_int(p) __atomic_load_n((unsigned int *)(p), __ATOMIC_RELAXED)
+#else
 #define pl_deref_int(p) ({ volatile unsigned int *__pl_i = (unsigned int *)(p); *__pl_i; })
+#endif
 
 /* This function waits for <lock> to release all bits covered by <mask>, and
  * enforces an exponential backoff using CPU pauses to limit the pollution to
@@ -255,6 +325,8 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			if (__builtin_expect(__pl_r, 0))                                       \
 				pl_sub_noret((lock), PLOCK64_RL_1);                            \
 		}                                                                              \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_ATO);                      \
 		!__pl_r; /* return value */                                                    \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		register unsigned int __pl_r = pl_deref_int(lock) & PLOCK32_WL_ANY;            \
@@ -264,6 +336,8 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			if (__builtin_expect(__pl_r, 0))                                       \
 				pl_sub_noret((lock), PLOCK32_RL_1);                            \
 		}                                                                              \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_ATO);                      \
 		!__pl_r; /* return value */                                                    \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_try_r__(char *,int);                   \
@@ -292,6 +366,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 				__old_r = pl_sub_lax(__lk_r, __set_r);                         \
 			}                                                                      \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_ATO);                              \
 		pl_barrier();                                                                  \
 		0;                                                                             \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
@@ -308,6 +383,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 				__old_r = pl_sub_lax(__lk_r, __set_r);                         \
 			}                                                                      \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_ATO);                              \
 		pl_barrier();                                                                  \
 		0;                                                                             \
 	}) : ({                                                                                \
@@ -321,9 +397,11 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 #define pl_drop_r(lock) (                                                                      \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_SHR);                                            \
 		pl_sub_noret_rel(lock, PLOCK64_RL_1);                                          \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_SHR);                                            \
 		pl_sub_noret_rel(lock, PLOCK32_RL_1);                                          \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_drop_r__(char *,int);                  \
@@ -343,6 +421,8 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			if (__builtin_expect(__pl_r, 0))                                       \
 				pl_sub_noret_lax((lock), PLOCK64_SL_1 | PLOCK64_RL_1);         \
 		}                                                                              \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_ATO);                      \
 		!__pl_r; /* return value */                                                    \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		register unsigned int __pl_r = pl_deref_int(lock);                             \
@@ -353,6 +433,8 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			if (__builtin_expect(__pl_r, 0))                                       \
 				pl_sub_noret_lax((lock), PLOCK32_SL_1 | PLOCK32_RL_1);         \
 		}                                                                              \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_ATO);                      \
 		!__pl_r; /* return value */                                                    \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_try_s__(char *,int);                   \
@@ -378,6 +460,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			pl_sub_noret_lax(__lk_r, __set_r);                                     \
 			pl_wait_unlock_long(__lk_r, __msk_r);                                  \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_ATO);                              \
 		pl_barrier();                                                                  \
 		0;                                                                             \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
@@ -390,6 +473,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			pl_sub_noret_lax(__lk_r, __set_r);                                     \
 			pl_wait_unlock_int(__lk_r, __msk_r);                                   \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_ATO);                              \
 		pl_barrier();                                                                  \
 		0;                                                                             \
 	}) : ({                                                                                \
@@ -403,9 +487,11 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 #define pl_drop_s(lock) (                                                                      \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_EXC | PL_TSAN_SHR);                              \
 		pl_sub_noret_rel(lock, PLOCK64_SL_1 + PLOCK64_RL_1);                           \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_EXC | PL_TSAN_SHR);                              \
 		pl_sub_noret_rel(lock, PLOCK32_SL_1 + PLOCK32_RL_1);                           \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_drop_s__(char *,int);                  \
@@ -418,9 +504,11 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 #define pl_stor(lock) (                                                                        \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_EXC);                                            \
 		pl_sub_noret(lock, PLOCK64_SL_1);                                              \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_EXC);                                            \
 		pl_sub_noret(lock, PLOCK32_SL_1);                                              \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_stor__(char *,int);                    \
@@ -435,11 +523,13 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 		register unsigned long __pl_r = pl_ldadd((lock), PLOCK64_WL_1);                \
 		if (__pl_r & (PLOCK64_RL_ANY & ~PLOCK64_RL_1))                                 \
 			__pl_r = pl_wait_unlock_long((const unsigned long*)lock, (PLOCK64_RL_ANY & ~PLOCK64_RL_1));  \
+		pl_tsan_acquire(lock, PL_TSAN_SHR);                                            \
 		pl_barrier();                                                                  \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		register unsigned int __pl_r = pl_ldadd((lock), PLOCK32_WL_1);                 \
 		if (__pl_r & (PLOCK32_RL_ANY & ~PLOCK32_RL_1))                                 \
 			__pl_r = pl_wait_unlock_int((const unsigned int*)lock, (PLOCK32_RL_ANY & ~PLOCK32_RL_1)); \
+		pl_tsan_acquire(lock, PL_TSAN_SHR);                                            \
 		pl_barrier();                                                                  \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_stow__(char *,int);                    \
@@ -452,9 +542,11 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 #define pl_wtos(lock) (                                                                        \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_EXC);                                            \
 		pl_sub_noret(lock, PLOCK64_WL_1);                                              \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_EXC);                                            \
 		pl_sub_noret(lock, PLOCK32_WL_1);                                              \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_wtos__(char *,int);                    \
@@ -467,9 +559,11 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 #define pl_wtor(lock) (                                                                        \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_EXC);                                            \
 		pl_sub_noret(lock, PLOCK64_WL_1 | PLOCK64_SL_1);                               \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_EXC);                                            \
 		pl_sub_noret(lock, PLOCK32_WL_1 | PLOCK32_SL_1);                               \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_wtor__(char *,int);                    \
@@ -505,11 +599,15 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 				__pl_r &= (PLOCK64_WL_ANY | PLOCK64_SL_ANY); /* return value */\
 			} else {                                                               \
 				/* wait for all other readers to leave */                      \
+				__pl_r &= PLOCK64_RL_ANY; /* ignore application bits */        \
 				while (__pl_r)                                                 \
-					__pl_r = pl_deref_long(lock) -                         \
-						(PLOCK64_WL_1 | PLOCK64_SL_1 | PLOCK64_RL_1);  \
+					__pl_r = (pl_deref_long(lock) -                        \
+						 (PLOCK64_WL_1 | PLOCK64_SL_1 | PLOCK64_RL_1)) & \
+						PLOCK64_RL_ANY;                                \
 			}                                                                      \
 		}                                                                              \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR | PL_TSAN_ATO);        \
 		!__pl_r; /* return value */                                                    \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		register unsigned int __pl_r = pl_deref_int(lock);                             \
@@ -522,11 +620,15 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 				__pl_r &= (PLOCK32_WL_ANY | PLOCK32_SL_ANY); /* return value */\
 			} else {                                                               \
 				/* wait for all other readers to leave */                      \
+				__pl_r &= PLOCK32_RL_ANY; /* ignore application bits */        \
 				while (__pl_r)                                                 \
-					__pl_r = pl_deref_int(lock) -                          \
-						(PLOCK32_WL_1 | PLOCK32_SL_1 | PLOCK32_RL_1);  \
+					__pl_r = (pl_deref_int(lock) -                         \
+						 (PLOCK32_WL_1 | PLOCK32_SL_1 | PLOCK32_RL_1)) & \
+						PLOCK32_RL_ANY;                                \
 			}                                                                      \
 		}                                                                              \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR | PL_TSAN_ATO);        \
 		!__pl_r; /* return value */                                                    \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_try_w__(char *,int);                   \
@@ -555,6 +657,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 		/* wait for all other readers to leave */                                      \
 		if (__builtin_expect(__pl_r & PLOCK64_RL_ANY, 0))            \
 			__pl_r = pl_wait_unlock_long(__lk_r, (PLOCK64_RL_ANY & ~PLOCK64_RL_1)) - __set_r;  \
+		pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR | PL_TSAN_ATO);                \
 		pl_barrier();                                                                  \
 		0;                                                                             \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
@@ -572,6 +675,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 		/* wait for all other readers to leave */                                      \
 		if (__builtin_expect(__pl_r & PLOCK32_RL_ANY, 0))            \
 			__pl_r = pl_wait_unlock_int(__lk_r, (PLOCK32_RL_ANY & ~PLOCK32_RL_1)) - __set_r;  \
+		pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR | PL_TSAN_ATO);                \
 		pl_barrier();                                                                  \
 		0;                                                                             \
 	}) : ({                                                                                \
@@ -585,9 +689,11 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 #define pl_drop_w(lock) (                                                                      \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_EXC | PL_TSAN_SHR);                              \
 		pl_sub_noret_rel(lock, PLOCK64_WL_1 | PLOCK64_SL_1 | PLOCK64_RL_1);            \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_EXC | PL_TSAN_SHR);                              \
 		pl_sub_noret_rel(lock, PLOCK32_WL_1 | PLOCK32_SL_1 | PLOCK32_RL_1);            \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_drop_w__(char *,int);                  \
@@ -607,12 +713,16 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 		__pl_r = pl_ldadd_acq((lock), PLOCK64_SL_1) & (PLOCK64_WL_ANY | PLOCK64_SL_ANY);\
 		if (__builtin_expect(__pl_r, 0))                                               \
 			pl_sub_noret_lax((lock), PLOCK64_SL_1);                                \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC);                                    \
 		!__pl_r; /* return value */                                                    \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		register unsigned int __pl_r;                                                  \
 		__pl_r = pl_ldadd_acq((lock), PLOCK32_SL_1) & (PLOCK32_WL_ANY | PLOCK32_SL_ANY);\
 		if (__builtin_expect(__pl_r, 0))                                               \
 			pl_sub_noret_lax((lock), PLOCK32_SL_1);                                \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC);                                    \
 		!__pl_r; /* return value */                                                    \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_try_rtos__(char *,int);                \
@@ -644,11 +754,15 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 				continue;  /* lock was released, try again */                  \
 			}                                                                      \
 			/* ok we're the only writer, wait for readers to leave */              \
+			__pl_r &= PLOCK64_RL_ANY; /* ignore application bits */                \
 			while (__builtin_expect(__pl_r, 0))                                    \
-				__pl_r = pl_deref_long(__lk_r) - (PLOCK64_WL_1|PLOCK64_SL_1|PLOCK64_RL_1); \
+				__pl_r = (pl_deref_long(__lk_r) - (PLOCK64_WL_1|PLOCK64_SL_1|PLOCK64_RL_1)) & \
+					PLOCK64_RL_ANY;                                        \
 			/* now return with __pl_r = 0 */                                       \
 			break;                                                                 \
 		}                                                                              \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR);                      \
 		!__pl_r; /* return value */                                                    \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		register unsigned int *__lk_r = (unsigned int *)(lock);                        \
@@ -664,11 +778,15 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 				continue;  /* lock was released, try again */                  \
 			}                                                                      \
 			/* ok we're the only writer, wait for readers to leave */              \
+			__pl_r &= PLOCK32_RL_ANY; /* ignore application bits */                \
 			while (__builtin_expect(__pl_r, 0))                                    \
-				__pl_r = pl_deref_int(__lk_r) - (PLOCK32_WL_1|PLOCK32_SL_1|PLOCK32_RL_1); \
+				__pl_r = (pl_deref_int(__lk_r) - (PLOCK32_WL_1|PLOCK32_SL_1|PLOCK32_RL_1)) & \
+					PLOCK32_RL_ANY;                                        \
 			/* now return with __pl_r = 0 */                                       \
 			break;                                                                 \
 		}                                                                              \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR);                      \
 		!__pl_r; /* return value */                                                    \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_try_rtow__(char *,int);                \
@@ -704,6 +822,8 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 				__pl_r = pl_deref_long(lock);                                  \
 			}                                                                      \
 		}                                                                              \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR);                      \
 		!__pl_r; /* return value */                                                    \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		register unsigned int __pl_r = pl_deref_int(lock) & PLOCK32_SL_ANY;            \
@@ -721,6 +841,8 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 				__pl_r = pl_deref_int(lock);                                   \
 			}                                                                      \
 		}                                                                              \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR);                      \
 		!__pl_r; /* return value */                                                    \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_try_a__(char *,int);                   \
@@ -751,6 +873,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			pl_cpu_relax(); pl_cpu_relax(); pl_cpu_relax();                        \
 			__pl_r = pl_deref_long(lock);                                          \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR);                              \
 		pl_barrier();                                                                  \
 		0;                                                                             \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
@@ -770,6 +893,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			pl_cpu_relax(); pl_cpu_relax(); pl_cpu_relax();                        \
 			__pl_r = pl_deref_int(lock);                                           \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR);                              \
 		pl_barrier();                                                                  \
 		0;                                                                             \
 	}) : ({                                                                                \
@@ -783,9 +907,11 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 #define pl_drop_a(lock) (                                                                      \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_ATO);                                            \
 		pl_sub_noret_rel(lock, PLOCK64_WL_1);                                          \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_ATO);                                            \
 		pl_sub_noret_rel(lock, PLOCK32_WL_1);                                          \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_drop_a__(char *,int);                  \
@@ -797,6 +923,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 /* Downgrade A to R. Inc(R), dec(W) then wait for W==0 */
 #define pl_ator(lock) (                                                                        \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
+		pl_tsan_release(lock, PL_TSAN_ATO);                                            \
 		register unsigned long *__lk_r = (unsigned long *)(lock);                      \
 		register unsigned long __set_r = PLOCK64_RL_1 - PLOCK64_WL_1;                  \
 		register unsigned long __msk_r = PLOCK64_WL_ANY;                               \
@@ -804,8 +931,10 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 		while (__builtin_expect(__pl_r & __msk_r, 0)) {                                \
 			__pl_r = pl_wait_unlock_long(__lk_r, __msk_r);                         \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_ATO);                                            \
 		pl_barrier();                                                                  \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
+		pl_tsan_release(lock, PL_TSAN_ATO);                                            \
 		register unsigned int *__lk_r = (unsigned int *)(lock);                        \
 		register unsigned int __set_r = PLOCK32_RL_1 - PLOCK32_WL_1;                   \
 		register unsigned int __msk_r = PLOCK32_WL_ANY;                                \
@@ -813,6 +942,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 		while (__builtin_expect(__pl_r & __msk_r, 0)) {                                \
 			__pl_r = pl_wait_unlock_int(__lk_r, __msk_r);                          \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_ATO);                                            \
 		pl_barrier();                                                                  \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_ator__(char *,int);                    \
@@ -831,6 +961,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
  */
 #define pl_try_rtoa(lock) (                                                                    \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
+		pl_tsan_release(lock, PL_TSAN_SHR);                                            \
 		register unsigned long __pl_r = pl_deref_long(lock) & PLOCK64_SL_ANY;          \
 		pl_barrier();                                                                  \
 		if (!__builtin_expect(__pl_r, 0)) {                                            \
@@ -846,8 +977,11 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 				__pl_r = pl_deref_long(lock);                                  \
 			}                                                                      \
 		}                                                                              \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR);                      \
 		!__pl_r; /* return value */                                                    \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
+		pl_tsan_release(lock, PL_TSAN_SHR);                                            \
 		register unsigned int __pl_r = pl_deref_int(lock) & PLOCK32_SL_ANY;            \
 		pl_barrier();                                                                  \
 		if (!__builtin_expect(__pl_r, 0)) {                                            \
@@ -863,6 +997,8 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 				__pl_r = pl_deref_int(lock);                                   \
 			}                                                                      \
 		}                                                                              \
+		if (!__pl_r)                                                                   \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR);                      \
 		!__pl_r; /* return value */                                                    \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_try_rtoa__(char *,int);                \
@@ -881,6 +1017,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 /* Upgrade R to J. Inc(W) then wait for R==W or S != 0 */
 #define pl_rtoj(lock) (                                                                        \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
+		pl_tsan_release(lock, PL_TSAN_SHR);                                            \
 		register unsigned long *__lk_r = (unsigned long *)(lock);                      \
 		register unsigned long __pl_r = pl_ldadd_acq(__lk_r, PLOCK64_WL_1) + PLOCK64_WL_1;\
 		register unsigned char __m = 0;                                                \
@@ -894,8 +1031,10 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			} while (--__loops);                                                   \
 			__pl_r = pl_deref_long(__lk_r);                                        \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_SHR);                                            \
 		pl_barrier();                                                                  \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
+		pl_tsan_release(lock, PL_TSAN_SHR);                                            \
 		register unsigned int *__lk_r = (unsigned int *)(lock);                        \
 		register unsigned int __pl_r = pl_ldadd_acq(__lk_r, PLOCK32_WL_1) + PLOCK32_WL_1;\
 		register unsigned char __m = 0;                                                \
@@ -909,6 +1048,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			} while (--__loops);                                                   \
 			__pl_r = pl_deref_int(__lk_r);                                         \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_SHR);                                            \
 		pl_barrier();                                                                  \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_rtoj__(char *,int);                    \
@@ -941,6 +1081,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 /* Upgrade R to C. Inc(W) then wait for R==W or S != 0 */
 #define pl_rtoc(lock) (                                                                        \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
+		pl_tsan_release(lock, PL_TSAN_SHR);                                            \
 		register unsigned long *__lk_r = (unsigned long *)(lock);                      \
 		register unsigned long __pl_r = pl_ldadd_acq(__lk_r, PLOCK64_WL_1) + PLOCK64_WL_1;\
 		register unsigned char __m = 0;                                                \
@@ -958,8 +1099,10 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			} while (--__loops);                                                   \
 			__pl_r = pl_deref_long(__lk_r);                                        \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_SHR);                                            \
 		pl_barrier();                                                                  \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
+		pl_tsan_release(lock, PL_TSAN_SHR);                                            \
 		register unsigned int *__lk_r = (unsigned int *)(lock);                        \
 		register unsigned int __pl_r = pl_ldadd_acq(__lk_r, PLOCK32_WL_1) + PLOCK32_WL_1;\
 		register unsigned char __m = 0;                                                \
@@ -977,6 +1120,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			} while (--__loops);                                                   \
 			__pl_r = pl_deref_int(__lk_r);                                         \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_SHR);                                            \
 		pl_barrier();                                                                  \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_rtoj__(char *,int);                    \
@@ -988,6 +1132,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 /* Drop the claim (C) lock : R--,W-- then clear S if !R */
 #define pl_drop_c(lock) (                                                                      \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
+		pl_tsan_release(lock, PL_TSAN_SHR | PL_TSAN_ATO);                              \
 		register unsigned long *__lk_r = (unsigned long *)(lock);                      \
 		register unsigned long __set_r = - PLOCK64_RL_1 - PLOCK64_WL_1;                \
 		register unsigned long __pl_r = pl_ldadd(__lk_r, __set_r) + __set_r;           \
@@ -995,6 +1140,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			pl_and_noret(__lk_r, ~PLOCK64_SL_1);                                   \
 		pl_barrier();                                                                  \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
+		pl_tsan_release(lock, PL_TSAN_SHR | PL_TSAN_ATO);                              \
 		register unsigned int *__lk_r = (unsigned int *)(lock);                        \
 		register unsigned int __set_r = - PLOCK32_RL_1 - PLOCK32_WL_1;                 \
 		register unsigned int __pl_r = pl_ldadd(__lk_r, __set_r) + __set_r;            \
@@ -1011,6 +1157,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 /* Upgrade C to A. R-- then wait for !S or clear S if !R */
 #define pl_ctoa(lock) (                                                                        \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
+		pl_tsan_release(lock, PL_TSAN_SHR);                                            \
 		register unsigned long *__lk_r = (unsigned long *)(lock);                      \
 		register unsigned long __pl_r = pl_ldadd(__lk_r, -PLOCK64_RL_1) - PLOCK64_RL_1;\
 		while (__pl_r & PLOCK64_SL_ANY) {                                              \
@@ -1022,8 +1169,10 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			pl_cpu_relax();                                                        \
 			__pl_r = pl_deref_long(__lk_r);                                        \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_SHR);                                            \
 		pl_barrier();                                                                  \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
+		pl_tsan_release(lock, PL_TSAN_SHR);                                            \
 		register unsigned int *__lk_r = (unsigned int *)(lock);                        \
 		register unsigned int __pl_r = pl_ldadd(__lk_r, -PLOCK32_RL_1) - PLOCK32_RL_1; \
 		while (__pl_r & PLOCK32_SL_ANY) {                                              \
@@ -1035,6 +1184,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			pl_cpu_relax();                                                        \
 			__pl_r = pl_deref_int(__lk_r);                                         \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_SHR);                                            \
 		pl_barrier();                                                                  \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_ctoa__(char *,int);                    \
@@ -1064,9 +1214,15 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
  */
 #define pl_last_writer(lock) (                                                                 \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
-		!(pl_deref_long(lock) & PLOCK64_WL_2PL);                                       \
+		register int __pl_r = !(pl_deref_long(lock) & PLOCK64_WL_2PL);                 \
+		if (__pl_r)                                                                    \
+			pl_tsan_acquire(lock, PL_TSAN_ATO);                                    \
+		__pl_r; /* return value */                                                     \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
-		!(pl_deref_int(lock) & PLOCK32_WL_2PL);                                        \
+		register int __pl_r = !(pl_deref_int(lock) & PLOCK32_WL_2PL);                  \
+		if (__pl_r)                                                                    \
+			pl_tsan_acquire(lock, PL_TSAN_ATO);                                    \
+		__pl_r; /* return value */                                                     \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_last_j__(char *,int);                  \
 		if (sizeof(*(lock)) != 4 && (sizeof(long) != 8 || sizeof(*(lock)) != 8))       \
@@ -1111,6 +1267,8 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			} while (--__loops);                                                   \
 			__pl_r = pl_deref_long(__lk_r);                                        \
 		}                                                                              \
+		if (__pl_r)                                                                    \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR | PL_TSAN_ATO);        \
 		pl_barrier();                                                                  \
 		__pl_r; /* return value, cannot be null on success */                          \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
@@ -1139,6 +1297,8 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			} while (--__loops);                                                   \
 			__pl_r = pl_deref_int(__lk_r);                                         \
 		}                                                                              \
+		if (__pl_r)                                                                    \
+			pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR | PL_TSAN_ATO);        \
 		pl_barrier();                                                                  \
 		__pl_r; /* return value, cannot be null on success */                          \
 	}) : ({                                                                                \
@@ -1185,6 +1345,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			} while (--__loops);                                                   \
 			__pl_r = pl_deref_long(__lk_r);                                        \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR | PL_TSAN_ATO);                \
 		pl_barrier();                                                                  \
 		0;                                                                             \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
@@ -1214,6 +1375,7 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 			} while (--__loops);                                                   \
 			__pl_r = pl_deref_int(__lk_r);                                         \
 		}                                                                              \
+		pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR | PL_TSAN_ATO);                \
 		pl_barrier();                                                                  \
 		0;                                                                             \
 	}) : ({                                                                                \
@@ -1228,9 +1390,11 @@ static unsigned int pl_wait_new_int(const unsigned int *lock, const unsigned int
 #define pl_drop_j(lock) (                                                                      \
 	(sizeof(long) == 8 && sizeof(*(lock)) == 8) ? ({                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_SHR | PL_TSAN_ATO);                              \
 		pl_sub_noret_rel(lock, PLOCK64_WL_1 | PLOCK64_RL_1);                           \
 	}) : (sizeof(*(lock)) == 4) ? ({                                                       \
 		pl_barrier();                                                                  \
+		pl_tsan_release(lock, PL_TSAN_SHR | PL_TSAN_ATO);                              \
 		pl_sub_noret_rel(lock, PLOCK32_WL_1 | PLOCK32_RL_1);                           \
 	}) : ({                                                                                \
 		void __unsupported_argument_size_for_pl_drop_j__(char *,int);                  \
@@ -1314,8 +1478,10 @@ static inline void pl_lorw_rdlock(unsigned long *lock)
 	 * structs.
 	 */
 	lk = pl_cmpxchg(lock, 0, PLOCK_LORW_SHR_BASE);
-	if (!lk)
+	if (!lk) {
+		pl_tsan_acquire(lock, PL_TSAN_EXC);
 		return;
+	}
 
 	/* so we were not alone, make sure there's no writer waiting for the
 	 * lock to be empty of visitors.
@@ -1337,6 +1503,7 @@ static inline void pl_lorw_rdlock(unsigned long *lock)
 #else
 		lk = pl_wait_unlock_long(lock, PLOCK_LORW_EXC_MASK);
 #endif
+	pl_tsan_acquire(lock, PL_TSAN_EXC);
 }
 
 
@@ -1395,18 +1562,21 @@ static inline void pl_lorw_wrlock(unsigned long *lock)
 	/* done, not waiting anymore, the WRQ bit if any, will be dropped by the
 	 * unlock
 	 */
+	pl_tsan_acquire(lock, PL_TSAN_EXC | PL_TSAN_SHR);
 }
 
 
 __attribute__((unused,always_inline,no_instrument_function))
 static inline void pl_lorw_rdunlock(unsigned long *lock)
 {
+	pl_tsan_release(lock, PL_TSAN_SHR);
 	pl_sub_noret_rel(lock, PLOCK_LORW_SHR_BASE);
 }
 
 __attribute__((unused,always_inline,no_instrument_function))
 static inline void pl_lorw_wrunlock(unsigned long *lock)
 {
+	pl_tsan_release(lock, PL_TSAN_EXC);
 	pl_and_noret_rel(lock, ~(PLOCK_LORW_WRQ_MASK | PLOCK_LORW_EXC_MASK));
 }
 
@@ -0,0 +1,304 @@
+/* plock - C++ scoped guards for progressive locks
+ *
+ * Copyright (C) 2026 Willy Tarreau <w@1wt.eu>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PL_PLOCK_HPP
+#define PL_PLOCK_HPP
+
+/* The classes below wrap the R, S, W and A states of plock.h into guards
+ * which take the lock when constructed and drop it when destroyed, so that
+ * an early return or an exception cannot leave a lock held, and the state
+ * being dropped is always the one the guard holds:
+ *
+ *   plock::read_guard<T>   pl_take_r() / pl_drop_r()
+ *   plock::seek_guard<T>   pl_take_s() / pl_drop_s()
+ *   plock::write_guard<T>  pl_take_w() / pl_drop_w()
+ *   plock::atomic_guard<T> pl_take_a() / pl_drop_a()
+ *
+ * Passing plock::try_take as a second argument uses pl_try_*() instead, and
+ * the guard then evaluates to false if the lock was not granted. A guard may
+ * be released early with unlock(), which does nothing on an empty guard (not
+ * granted, moved from or already unlocked), and moved but never copied.
+ *
+ * Transitions consume the guard of the current state and return the guard of
+ * the new one, so that there is never more than one guard representing the
+ * caller's state. They only exist on the states they apply to, and only on
+ * rvalues, so that a forgotten std::move() or an illegal transition such as
+ * R->W via pl_stow() are compile errors :
+ *
+ *   plock::seek_guard<unsigned long> s(lock);
+ *   plock::write_guard<unsigned long> w = std::move(s).stow();   // pl_stow()
+ *   plock::read_guard<unsigned long> r = std::move(w).wtor();    // pl_wtor()
+ *
+ * The stow(), stor(), wtos(), wtor() and ator() transitions always succeed.
+ * The try_rtos(), try_rtow() and try_rtoa() upgrades may fail, and are thus
+ * called on the read guard itself, which only gives its lock to the returned
+ * guard on success, and keeps R otherwise. As documented in plock.h, a failed
+ * upgrade must not be retried without dropping R first.
+ *
+ * T may be any 32-bit type, or any 64-bit type on 64-bit platforms. The
+ * lock_word<> template maps it at compile time to the unsigned int or unsigned
+ * long the macros are used with, and rejects any other size with a readable
+ * error. The guards only hold a pointer, and all of their functions are forced
+ * inline, so that once optimized, the code is the same as with the macros: a
+ * moved-from guard is known to be empty and its destructor disappears.
+ *
+ * The macros rely on typeof and statement expressions, so this requires a GNU
+ * C++ dialect (-std=gnu++11 or later, which is the compilers' default).
+ */
+
+/* The macros use "register", which C++17 removed, and declare their size error
+ * functions with a "char *" argument. Neither matters for the code produced,
+ * so these warnings are silenced for the lines of plock.h, which is why it is
+ * better included from here. Code using the macros directly will still see
+ * them, and may silence them the same way.
+ */
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wregister"
+#pragma GCC diagnostic ignored "-Wwrite-strings"
+#endif
+
+#include <utility>
+#include "plock.h"
+
+#define __PL_GUARD_INLINE __attribute__((always_inline,no_instrument_function)) inline
+
+namespace plock {
+
+/* tag used to request a non-blocking attempt */
+struct try_take_t { };
+const try_take_t try_take = try_take_t();
+
+/* maps a lock type to the word type the macros operate on, by size */
+template <typename T, unsigned long size = sizeof(T)>
+struct lock_word {
+	static_assert(sizeof(T) == 0, "plock guards require a 32-bit lock, or a 64-bit one on 64-bit platforms");
+};
+
+template <typename T>
+struct lock_word<T, 4> {
+	typedef unsigned int type;
+};
+
+#if __SIZEOF_LONG__ == 8
+template <typename T>
+struct lock_word<T, 8> {
+	typedef unsigned long type;
+};
+#endif
+
+template <typename T> class read_guard;
+template <typename T> class seek_guard;
+template <typename T> class write_guard;
+template <typename T> class atomic_guard;
+
+/* the common part of all guards : the lock word they hold, if any */
+template <typename T>
+class guard_base {
+public:
+	typedef typename lock_word<T>::type word;
+
+	explicit operator bool() const { return lk != nullptr; }
+
+	guard_base(const guard_base &) = delete;
+	guard_base &operator=(const guard_base &) = delete;
+	guard_base &operator=(guard_base &&) = delete;
+
+protected:
+	word *lk;
+
+	__PL_GUARD_INLINE explicit guard_base(word *l) : lk(l) { }
+	__PL_GUARD_INLINE explicit guard_base(T &l) : lk(reinterpret_cast<word *>(&l)) { }
+	__PL_GUARD_INLINE guard_base(guard_base &&o) : lk(o.lk) { o.lk = nullptr; }
+
+	/* gives up the lock word, leaving the guard empty */
+	__PL_GUARD_INLINE word *release() { word *l = lk; lk = nullptr; return l; }
+
+	friend class read_guard<T>;
+	friend class seek_guard<T>;
+	friend class write_guard<T>;
+	friend class atomic_guard<T>;
+};
+
+/* shared read access (R) */
+template <typename T>
+class read_guard : public guard_base<T> {
+	typedef typename guard_base<T>::word word;
+	using guard_base<T>::lk;
+
+	__PL_GUARD_INLINE explicit read_guard(word *l) : guard_base<T>(l) { }
+
+	friend class seek_guard<T>;
+	friend class write_guard<T>;
+	friend class atomic_guard<T>;
+public:
+	__PL_GUARD_INLINE explicit read_guard(T &l) : guard_base<T>(l) { pl_take_r(lk); }
+	__PL_GUARD_INLINE read_guard(T &l, try_take_t) : guard_base<T>(l) { if (!pl_try_r(lk)) lk = nullptr; }
+	__PL_GUARD_INLINE read_guard(read_guard &&o) : guard_base<T>(static_cast<guard_base<T> &&>(o)) { }
+	__PL_GUARD_INLINE ~read_guard() { if (lk) pl_drop_r(lk); }
+	__PL_GUARD_INLINE void unlock() { if (lk) pl_drop_r(lk); lk = nullptr; }
+
+	__PL_GUARD_INLINE seek_guard<T> try_rtos();
+	__PL_GUARD_INLINE write_guard<T> try_rtow();
+	__PL_GUARD_INLINE atomic_guard<T> try_rtoa();
+};
+
+/* seek access (S) */
+template <typename T>
+class seek_guard : public guard_base<T> {
+	typedef typename guard_base<T>::word word;
+	using guard_base<T>::lk;
+
+	__PL_GUARD_INLINE explicit seek_guard(word *l) : guard_base<T>(l) { }
+
+	friend class read_guard<T>;
+	friend class write_guard<T>;
+public:
+	__PL_GUARD_INLINE explicit seek_guard(T &l) : guard_base<T>(l) { pl_take_s(lk); }
+	__PL_GUARD_INLINE seek_guard(T &l, try_take_t) : guard_base<T>(l) { if (!pl_try_s(lk)) lk = nullptr; }
+	__PL_GUARD_INLINE seek_guard(seek_guard &&o) : guard_base<T>(static_cast<guard_base<T> &&>(o)) { }
+	__PL_GUARD_INLINE ~seek_guard() { if (lk) pl_drop_s(lk); }
+	__PL_GUARD_INLINE void unlock() { if (lk) pl_drop_s(lk); lk = nullptr; }
+
+	__PL_GUARD_INLINE write_guard<T> stow() &&;
+	__PL_GUARD_INLINE read_guard<T> stor() &&;
+};
+
+/* write access (W) */
+template <typename T>
+class write_guard : public guard_base<T> {
+	typedef typename guard_base<T>::word word;
+	using guard_base<T>::lk;
+
+	__PL_GUARD_INLINE explicit write_guard(word *l) : guard_base<T>(l) { }
+
+	friend class read_guard<T>;
+	friend class seek_guard<T>;
+public:
+	__PL_GUARD_INLINE explicit write_guard(T &l) : guard_base<T>(l) { pl_take_w(lk); }
+	__PL_GUARD_INLINE write_guard(T &l, try_take_t) : guard_base<T>(l) { if (!pl_try_w(lk)) lk = nullptr; }
+	__PL_GUARD_INLINE write_guard(write_guard &&o) : guard_base<T>(static_cast<guard_base<T> &&>(o)) { }
+	__PL_GUARD_INLINE ~write_guard() { if (lk) pl_drop_w(lk); }
+	__PL_GUARD_INLINE void unlock() { if (lk) pl_drop_w(lk); lk = nullptr; }
+
+	__PL_GUARD_INLINE seek_guard<T> wtos() &&;
+	__PL_GUARD_INLINE read_guard<T> wtor() &&;
+};
+
+/* atomic write access (A) */
+template <typename T>
+class atomic_guard : public guard_base<T> {
+	typedef typename guard_base<T>::word word;
+	using guard_base<T>::lk;
+
+	__PL_GUARD_INLINE explicit atomic_guard(word *l) : guard_base<T>(l) { }
+
+	friend class read_guard<T>;
+public:
+	__PL_GUARD_INLINE explicit atomic_guard(T &l) : guard_base<T>(l) { pl_take_a(lk); }
+	__PL_GUARD_INLINE atomic_guard(T &l, try_take_t) : guard_base<T>(l) { if (!pl_try_a(lk)) lk = nullptr; }
+	__PL_GUARD_INLINE atomic_guard(atomic_guard &&o) : guard_base<T>(static_cast<guard_base<T> &&>(o)) { }
+	__PL_GUARD_INLINE ~atomic_guard() { if (lk) pl_drop_a(lk); }
+	__PL_GUARD_INLINE void unlock() { if (lk) pl_drop_a(lk); lk = nullptr; }
+
+	__PL_GUARD_INLINE read_guard<T> ator() &&;
+};
+
+/* Tries to upgrade R to S. On success, the returned guard holds S and this one
+ * is empty. On failure, the returned guard is empty and this one still holds R.
+ */
+template <typename T>
+seek_guard<T> read_guard<T>::try_rtos()
+{
+	return seek_guard<T>(pl_try_rtos(lk) ? this->release() : nullptr);
+}
+
+/* Tries to upgrade R to W, waiting for other readers to leave. Same semantics
+ * as try_rtos() otherwise.
+ */
+template <typename T>
+write_guard<T> read_guard<T>::try_rtow()
+{
+	return write_guard<T>(pl_try_rtow(lk) ? this->release() : nullptr);
+}
+
+/* Tries to upgrade R to A, waiting for other readers to leave or to upgrade.
+ * Same semantics as try_rtos() otherwise.
+ */
+template <typename T>
+atomic_guard<T> read_guard<T>::try_rtoa()
+{
+	return atomic_guard<T>(pl_try_rtoa(lk) ? this->release() : nullptr);
+}
+
+/* S -> W, waiting for readers to leave */
+template <typename T>
+write_guard<T> seek_guard<T>::stow() &&
+{
+	pl_stow(lk);
+	return write_guard<T>(this->release());
+}
+
+/* S -> R */
+template <typename T>
+read_guard<T> seek_guard<T>::stor() &&
+{
+	pl_stor(lk);
+	return read_guard<T>(this->release());
+}
+
+/* W -> S */
+template <typename T>
+seek_guard<T> write_guard<T>::wtos() &&
+{
+	pl_wtos(lk);
+	return seek_guard<T>(this->release());
+}
+
+/* W -> R */
+template <typename T>
+read_guard<T> write_guard<T>::wtor() &&
+{
+	pl_wtor(lk);
+	return read_guard<T>(this->release());
+}
+
+/* A -> R, waiting for other A holders to leave. See pl_ator(). */
+template <typename T>
+read_guard<T> atomic_guard<T>::ator() &&
+{
+	pl_ator(lk);
+	return read_guard<T>(this->release());
+}
+
+} /* namespace plock */
+
+#undef __PL_GUARD_INLINE
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif /* PL_PLOCK_HPP */
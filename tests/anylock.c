@@ -0,0 +1,195 @@
+/*
+ * Multi-lock acquisition tester -- 2026-10-17
+ *
+ * Threads repeatedly take the W lock on any of a set of shards, hold it for
+ * some time, and release it. The shard is either found by polling pl_try_w()
+ * over all shards, or using pl_take_any_w() which spins briefly then sleeps
+ * on all shards at once with futex_waitv(). When there are more threads than
+ * shards and locks are held for a long time (-d), the polling threads waste
+ * CPU while the sleeping ones leave it to the holders. Each shard counts its
+ * accesses non-atomically under the lock to verify the exclusivity.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o anylock anylock.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pl-futex.h>
+
+#define MAXTHREADS 64
+#define MAXSHARDS  1024
+
+/* waiter bit used by pl_take_any_w(), one of the application bits */
+#define WBIT 1UL
+
+struct shard {
+	unsigned long lock;
+	unsigned long count;
+	char pad[64 - 2 * sizeof(long)];
+} __attribute__((aligned(64)));
+
+int arg_mode = 0;
+int arg_threads = 4;
+int arg_shards = 8;
+unsigned long arg_loops = 10000;
+unsigned int arg_work = 100;
+unsigned int arg_delay = 0;
+
+static struct shard shards[MAXSHARDS];
+static unsigned long *locks[MAXSHARDS];
+static volatile unsigned long step;
+static unsigned long cpu_ns[MAXTHREADS];
+static struct timeval start, stop;
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	unsigned long n;
+	unsigned int i, w;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; n < arg_loops; n++) {
+		if (arg_mode == 0) {
+			/* start on a different shard for each thread */
+			i = thr % arg_shards;
+			while (!pl_try_w(locks[i])) {
+				if (++i >= (unsigned int)arg_shards)
+					i = 0;
+				pl_cpu_relax();
+			}
+		}
+		else
+			i = pl_take_any_w(locks, arg_shards, WBIT);
+
+		shards[i].count++;
+		for (w = 0; w < arg_work; w++)
+			pl_cpu_relax();
+		if (arg_delay)
+			usleep(arg_delay);
+
+		if (arg_mode == 0)
+			pl_drop_w(locks[i]);
+		else
+			pl_drop_w_wake(locks[i], WBIT);
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: anylock [-h] [-m mode] [-t threads] [-s shards] [-l loops] [-w work] [-d delay_us]\n"
+	       "Modes :\n"
+	       "  0 : poll pl_try_w() over all shards\n"
+	       "  1 : pl_take_any_w() / pl_drop_w_wake()\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, total, cpu;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			arg_threads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-s")) {
+			if (--argc < 0)
+				usage(1);
+			arg_shards = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-w")) {
+			if (--argc < 0)
+				usage(1);
+			arg_work = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-d")) {
+			if (--argc < 0)
+				usage(1);
+			arg_delay = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 1 || !arg_loops ||
+	    arg_threads < 1 || arg_threads > MAXTHREADS ||
+	    arg_shards < 1 || arg_shards > MAXSHARDS)
+		usage(1);
+
+	for (i = 0; i < arg_shards; i++)
+		locks[i] = &shards[i].lock;
+
+	for (i = 0; i < arg_threads; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_threads; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	for (i = total = 0; i < arg_shards; i++) {
+		if (shards[i].lock & ~WBIT) {
+			fprintf(stderr, "Shard %ld left locked: %#lx!\n", i, shards[i].lock);
+			exit(1);
+		}
+		total += shards[i].count;
+	}
+
+	if (total != arg_threads * arg_loops) {
+		fprintf(stderr, "Bad total count %lu, expected %lu!\n", total, arg_threads * arg_loops);
+		exit(1);
+	}
+
+	for (i = cpu = 0; i < arg_threads; i++)
+		cpu += cpu_ns[i] / 1000;
+
+	printf("mode: %d threads: %d shards: %d loops: %lu time(ms): %lu rate(lps): %Lu, cpu(ms): %lu (%lu%%)\n",
+	       arg_mode, arg_threads, arg_shards, total, ms, total * 1000ULL / ms,
+	       cpu / 1000, cpu / 10 / ms);
+	exit(0);
+}
@@ -0,0 +1,284 @@
+/*
+ * Asynchronous lock acquisition tester -- 2026-10-17
+ *
+ * Threads repeatedly take the W lock on one of a set of shards, hold it for
+ * some time, and release it. The lock is either taken with pl_take_w() which
+ * spins until it gets it, or with pl_take_w_async() which queues a waiter
+ * record when the lock is busy. In this case the thread performs background
+ * work units until the releasing thread grants it the lock and calls the
+ * callback, which only flags the task as runnable. The background units
+ * count the CPU which would otherwise have been wasted spinning. Each shard
+ * counts its accesses non-atomically under the lock to verify exclusivity.
+ * Mode 2 mixes R, S and W requests on the same shards, R and S holders verify
+ * that the counter does not change while they hold the lock, so that waiters
+ * of different types get queued together and granted by the same release.
+ * This is first verified from a single thread before starting the threads.
+ * Since the lock is handed to waiters, a waiter preempted while queued keeps
+ * the lock busy, so the number of threads must not exceed the number of CPUs.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o asynclock asynclock.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pl-async.h>
+
+#define MAXTHREADS 64
+#define MAXSHARDS  1024
+
+struct shard {
+	struct pl_async_lock lock;
+	unsigned long count;
+	char pad[64 - 3 * sizeof(long)];
+} __attribute__((aligned(64)));
+
+struct task {
+	struct pl_async_waiter w;
+	unsigned int granted;
+	unsigned long bg;    /* background units performed */
+	unsigned long waits; /* number of times the task was queued */
+	unsigned long writes;
+	unsigned long errors;
+} __attribute__((aligned(64)));
+
+int arg_mode = 0;
+int arg_threads = 4;
+int arg_shards = 1;
+unsigned long arg_loops = 100000;
+unsigned int arg_work = 100;
+unsigned int arg_bgwork = 20;
+
+static struct shard shards[MAXSHARDS];
+static struct task tasks[MAXTHREADS];
+static volatile unsigned long step;
+static unsigned long cpu_ns[MAXTHREADS];
+static struct timeval start, stop;
+
+/* called with the lock held on behalf of the task, possibly by another
+ * thread. It only marks the task as runnable.
+ */
+static void granted_cb(struct pl_async_waiter *w)
+{
+	struct task *t = w->arg;
+
+	pl_store(&t->granted, 1);
+}
+
+/* callback used by check_mixed(), which releases the lock it was granted */
+static void mixed_cb(struct pl_async_waiter *w)
+{
+	struct pl_async_lock *al = w->arg;
+
+	w->arg = NULL;
+	if (w->type == PL_TAKE_W)
+		pl_drop_w_async(al, NULL);
+	else if (w->type == PL_TAKE_S)
+		pl_drop_s_async(al, NULL);
+	else
+		pl_drop_r_async(al, NULL);
+}
+
+/* From a single thread, queues R, S, W, R waiters behind a W lock, and
+ * releases it. All of them must be granted in turn by the release, including
+ * W which is queued behind readers granted by the same release. Returns
+ * non-zero on success.
+ */
+static int check_mixed(void)
+{
+	static const int types[] = { PL_TAKE_R, PL_TAKE_S, PL_TAKE_W, PL_TAKE_R };
+	struct pl_async_waiter w[4];
+	struct pl_async_lock al = { 0, NULL };
+	int i;
+
+	pl_take_w(&al.lock);
+	for (i = 0; i < 4; i++) {
+		if (pl_take_async(&al, types[i], &w[i], mixed_cb, &al))
+			return 0;
+	}
+	pl_drop_w_async(&al, NULL);
+
+	for (i = 0; i < 4; i++) {
+		if (w[i].arg)
+			return 0;
+	}
+	return !al.lock && !al.waiters;
+}
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	struct task *t = &tasks[thr];
+	unsigned long n, cnt;
+	unsigned int i, w;
+	int type;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; n < arg_loops; n++) {
+		i = (thr + n) % arg_shards;
+		type = PL_TAKE_W;
+		if (arg_mode == 2)
+			type = ((thr + n) % 4 == 0) ? PL_TAKE_W : ((thr + n) % 4 == 1) ? PL_TAKE_S : PL_TAKE_R;
+
+		if (arg_mode == 0)
+			pl_take_w(&shards[i].lock.lock);
+		else if (!pl_take_async(&shards[i].lock, type, &t->w, granted_cb, t)) {
+			/* queued: perform other work until granted */
+			t->waits++;
+			while (!pl_load(&t->granted)) {
+				for (w = 0; w < arg_bgwork; w++)
+					pl_cpu_relax();
+				t->bg++;
+			}
+			t->granted = 0;
+		}
+
+		if (type == PL_TAKE_W) {
+			shards[i].count++;
+			t->writes++;
+			for (w = 0; w < arg_work; w++)
+				pl_cpu_relax();
+			pl_drop_w_async(&shards[i].lock, NULL);
+			continue;
+		}
+
+		cnt = shards[i].count;
+		for (w = 0; w < arg_work; w++)
+			pl_cpu_relax();
+		if (shards[i].count != cnt)
+			t->errors++;
+
+		if (type == PL_TAKE_S)
+			pl_drop_s_async(&shards[i].lock, NULL);
+		else
+			pl_drop_r_async(&shards[i].lock, NULL);
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: asynclock [-h] [-m mode] [-t threads] [-s shards] [-l loops] [-w work] [-b bgwork]\n"
+	       "Modes :\n"
+	       "  0 : spin in pl_take_w()\n"
+	       "  1 : pl_take_w_async(), perform background work while queued\n"
+	       "  2 : same as 1 with a mix of R, S and W requests\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, total, cpu, bg, waits, writes, errors;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			arg_threads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-s")) {
+			if (--argc < 0)
+				usage(1);
+			arg_shards = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-w")) {
+			if (--argc < 0)
+				usage(1);
+			arg_work = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-b")) {
+			if (--argc < 0)
+				usage(1);
+			arg_bgwork = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 2 || !arg_loops ||
+	    arg_threads < 1 || arg_threads > MAXTHREADS ||
+	    arg_shards < 1 || arg_shards > MAXSHARDS)
+		usage(1);
+
+	if (arg_mode == 2 && !check_mixed()) {
+		fprintf(stderr, "Mixed waiters not granted!\n");
+		exit(1);
+	}
+
+	for (i = 0; i < arg_threads; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_threads; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	for (i = total = 0; i < arg_shards; i++) {
+		if (shards[i].lock.lock || shards[i].lock.waiters) {
+			fprintf(stderr, "Shard %ld left locked: %#lx!\n", i, shards[i].lock.lock);
+			exit(1);
+		}
+		total += shards[i].count;
+	}
+
+	for (i = cpu = bg = waits = writes = errors = 0; i < arg_threads; i++) {
+		cpu += cpu_ns[i] / 1000;
+		bg += tasks[i].bg;
+		waits += tasks[i].waits;
+		writes += tasks[i].writes;
+		errors += tasks[i].errors;
+	}
+
+	if (total != writes || errors) {
+		fprintf(stderr, "Bad total count %lu, expected %lu, %lu inconsistencies!\n", total, writes, errors);
+		exit(1);
+	}
+
+	total = arg_threads * arg_loops;
+	printf("mode: %d threads: %d shards: %d loops: %lu writes: %lu time(ms): %lu rate(lps): %Lu, cpu(ms): %lu (%lu%%) waits: %lu bgunits: %lu\n",
+	       arg_mode, arg_threads, arg_shards, total, writes, ms, total * 1000ULL / ms,
+	       cpu / 1000, cpu / 10 / ms, waits, bg);
+	exit(0);
+}
@@ -0,0 +1,157 @@
+/*
+ * Barrier latency tester -- 2026-10-17
+ *
+ * Threads repeatedly wait on a barrier, using either a pthread_barrier_t, or
+ * a pl_barrier on which they spin, or on which they spin then sleep. Each
+ * thread counts its arrivals in a shared counter before the barrier, and
+ * verifies after it that all threads arrived for the current round and that
+ * none is more than one round ahead. The reported latency is the average
+ * time per round.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o barrier barrier.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pl-barrier.h>
+
+#define MAXTHREADS 256
+
+int arg_mode = 0;
+int arg_threads = 4;
+unsigned long arg_loops = 100000;
+unsigned int arg_work = 0;
+
+static pthread_barrier_t pbar;
+static struct pl_barrier plbar;
+static struct pl_barrier_node nodes[MAXTHREADS];
+static unsigned long arrived;
+static volatile unsigned long step;
+static unsigned long cpu_ns[MAXTHREADS];
+static struct timeval start, stop;
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	unsigned long n, cnt;
+	unsigned int w;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; n < arg_loops; n++) {
+		for (w = 0; w < arg_work; w++)
+			pl_cpu_relax();
+
+		pl_inc_noret(&arrived);
+
+		if (arg_mode == 0)
+			pthread_barrier_wait(&pbar);
+		else if (arg_mode == 1)
+			pl_barrier_spin(&plbar, thr);
+		else
+			pl_barrier_wait(&plbar, thr);
+
+		cnt = pl_deref_long(&arrived);
+		if (cnt < (n + 1) * arg_threads || cnt > (n + 2) * arg_threads) {
+			fprintf(stderr, "Thread %ld round %lu: bad arrival count %lu!\n", thr, n, cnt);
+			exit(1);
+		}
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: barrier [-h] [-m mode] [-t threads] [-l loops] [-w work]\n"
+	       "Modes :\n"
+	       "  0 : pthread_barrier_wait()\n"
+	       "  1 : pl_barrier_spin()\n"
+	       "  2 : pl_barrier_wait()\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, us, cpu;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			arg_threads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-w")) {
+			if (--argc < 0)
+				usage(1);
+			arg_work = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 2 || !arg_loops ||
+	    arg_threads < 1 || arg_threads > MAXTHREADS)
+		usage(1);
+
+	pthread_barrier_init(&pbar, NULL, arg_threads);
+	pl_barrier_init(&plbar, nodes, arg_threads);
+
+	for (i = 0; i < arg_threads; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_threads; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	us = (stop.tv_sec - start.tv_sec) * 1000000 + ((long)stop.tv_usec - (long)start.tv_usec);
+	ms = us / 1000;
+	if (!ms)
+		ms = 1;
+
+	for (i = cpu = 0; i < arg_threads; i++)
+		cpu += cpu_ns[i] / 1000;
+
+	printf("mode: %d threads: %d rounds: %lu time(ms): %lu latency(ns): %Lu, cpu(ms): %lu (%lu%%)\n",
+	       arg_mode, arg_threads, arg_loops, ms, us * 1000ULL / arg_loops,
+	       cpu / 1000, cpu / 10 / ms);
+	exit(0);
+}
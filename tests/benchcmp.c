@@ -0,0 +1,388 @@
+/*
+ * Benchmark results comparator -- 2026-10-17
+ *
+ * Compares two sets of benchmark results, typically collected before and
+ * after a change to plock.h or atomic-ops.h, and reports for each test
+ * configuration the relative change of the median with its significance.
+ *
+ * Results are stored in plain text files, one sample per line :
+ *
+ *     <config> <value>
+ *
+ * where <config> is a single word describing the test (e.g. the program
+ * and its arguments, such as "lrubench:t8:m5") and <value> is the measured
+ * figure (e.g. the rate in loops per second). Repeating a line with the same
+ * config adds one sample to it. Empty lines and lines starting with '#' are
+ * ignored. The runbench.sh script produces such files from the output of the
+ * test programs.
+ *
+ * For each config present in both files, the median of each set is reported
+ * with the relative delta, the two-sided p-value of a Mann-Whitney U test
+ * (exact for small samples without ties, otherwise using the normal
+ * approximation with tie correction), and a bootstrap confidence interval of
+ * the relative delta of the medians. A change is considered significant when
+ * the p-value is below alpha ("-a", 0.05 by default), and is reported as a
+ * regression when it is also worse than the threshold ("-t", 2% by default).
+ * Higher values are considered better unless "-l" is passed (for latencies).
+ * The exit status is 1 if at least one regression was found, 2 on error,
+ * otherwise 0.
+ *
+ * You can do whatever you want with this program, I'm not responsible for any
+ * misuse.
+ *
+ * To compile :
+ *
+ *   gcc -O2 -o benchcmp benchcmp.c -lm
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MAXCONFIGS	4096
+#define MAXCFGLEN	128
+
+/* exact Mann-Whitney distribution is computed up to this many samples */
+#define EXACT_MAX	40
+
+/* runtime arguments */
+double arg_alpha = 0.05;
+double arg_threshold = 2.0; /* percent */
+unsigned int arg_boot = 2000;
+int arg_lower = 0;
+
+/* all samples of one test configuration in one result set */
+struct config {
+	char name[MAXCFGLEN];
+	double *val;
+	unsigned int nbval;
+	unsigned int alloc;
+};
+
+struct result_set {
+	struct config cfg[MAXCONFIGS];
+	unsigned int nbcfg;
+};
+
+static struct result_set before, after;
+
+/* Xorshift RNGs from http://www.jstatsoft.org/v08/i14/paper */
+static uint32_t rnd32_state = 2463534242U;
+
+static inline uint32_t rnd32()
+{
+        rnd32_state ^= rnd32_state << 13;
+        rnd32_state ^= rnd32_state >> 17;
+        rnd32_state ^= rnd32_state << 5;
+        return rnd32_state;
+}
+
+static inline uint32_t rnd32_range(uint32_t range)
+{
+        uint64_t res = rnd32();
+
+        res *= range;
+        return res >> 32;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* returns the config called <name> in <set>, or NULL if not found */
+static struct config *find_config(struct result_set *set, const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < set->nbcfg; i++)
+		if (strcmp(set->cfg[i].name, name) == 0)
+			return &set->cfg[i];
+	return NULL;
+}
+
+/* loads the results from file <file> into <set>. Returns < 0 on error. */
+static int load_results(const char *file, struct result_set *set)
+{
+	char line[1024], name[MAXCFGLEN];
+	struct config *cfg;
+	unsigned int lineno = 0;
+	double v;
+	FILE *f;
+
+	f = fopen(file, "r");
+	if (!f) {
+		perror(file);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		if (*line == '#' || sscanf(line, "%127s", name) != 1)
+			continue;
+
+		if (sscanf(line, "%*s %lf", &v) != 1) {
+			fprintf(stderr, "%s:%u: missing value for config '%s'\n", file, lineno, name);
+			fclose(f);
+			return -1;
+		}
+
+		cfg = find_config(set, name);
+		if (!cfg) {
+			if (set->nbcfg >= MAXCONFIGS) {
+				fprintf(stderr, "%s:%u: too many configs\n", file, lineno);
+				fclose(f);
+				return -1;
+			}
+			cfg = &set->cfg[set->nbcfg++];
+			strcpy(cfg->name, name);
+		}
+
+		if (cfg->nbval == cfg->alloc) {
+			cfg->alloc = cfg->alloc ? cfg->alloc * 2 : 16;
+			cfg->val = realloc(cfg->val, cfg->alloc * sizeof(*cfg->val));
+			if (!cfg->val) {
+				perror("realloc");
+				fclose(f);
+				return -1;
+			}
+		}
+		cfg->val[cfg->nbval++] = v;
+	}
+	fclose(f);
+
+	for (lineno = 0; lineno < set->nbcfg; lineno++)
+		qsort(set->cfg[lineno].val, set->cfg[lineno].nbval, sizeof(double), cmp_double);
+	return 0;
+}
+
+/* returns the median of the <n> sorted values in <v> */
+static double median(const double *v, unsigned int n)
+{
+	return (n & 1) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2.0;
+}
+
+/* returns the two-sided p-value of the Mann-Whitney U test between sorted
+ * samples <x> (size <n1>) and <y> (size <n2>).
+ */
+static double mann_whitney(const double *x, unsigned int n1, const double *y, unsigned int n2)
+{
+	unsigned int i, j, k, n = n1 + n2;
+	double r1 = 0.0, ties = 0.0, u, mu, sigma, z, p;
+	int has_ties = 0;
+
+	/* rank the merged samples, giving tied values their average rank */
+	i = j = 0;
+	while (i < n1 || j < n2) {
+		double v = (j >= n2 || (i < n1 && x[i] <= y[j])) ? x[i] : y[j];
+		unsigned int cx = 0, cy = 0, t;
+
+		while (i < n1 && x[i] == v) { i++; cx++; }
+		while (j < n2 && y[j] == v) { j++; cy++; }
+		t = cx + cy;
+		/* ranks from i+j-t+1 to i+j */
+		r1 += cx * ((double)(i + j - t + 1) + (double)(i + j)) / 2.0;
+		if (t > 1) {
+			ties += (double)t * t * t - t;
+			has_ties = 1;
+		}
+	}
+
+	u = r1 - (double)n1 * (n1 + 1) / 2.0;
+	mu = (double)n1 * n2 / 2.0;
+
+	if (!has_ties && n <= EXACT_MAX) {
+		/* exact distribution : cnt[k][u] = number of arrangements of k
+		 * values among the first samples giving statistic u, computed
+		 * iteratively over the number of samples.
+		 */
+		unsigned int umax = n1 * n2;
+		double *cnt = calloc((n1 + 1) * (umax + 1), sizeof(*cnt));
+		double tot = 0.0, tail = 0.0, lo = (u < mu) ? u : 2 * mu - u;
+
+		if (!cnt)
+			return 1.0;
+
+		/* f(m, k, u): m = samples seen, k = from x. We iterate on m and
+		 * update cnt[k][u] in reverse order of k, placing the m-th sample
+		 * either in x (adding the number of y already seen to u) or in y.
+		 */
+		cnt[0] = 1.0;
+		for (k = 0; k < n; k++) {
+			int kx;
+
+			for (kx = (k < n1 ? k : n1 - 1); kx >= 0; kx--) {
+				unsigned int ky = k - kx; /* y samples seen so far */
+				unsigned int uu;
+
+				if (ky > n2)
+					continue;
+				for (uu = umax - ky + 1; uu-- > 0; ) {
+					double c = cnt[kx * (umax + 1) + uu];
+					if (c != 0.0)
+						cnt[(kx + 1) * (umax + 1) + uu + ky] += c;
+				}
+			}
+		}
+		for (k = 0; k <= umax; k++) {
+			double c = cnt[n1 * (umax + 1) + k];
+			tot += c;
+			if (k <= lo)
+				tail += c;
+		}
+		free(cnt);
+		p = 2.0 * tail / tot;
+		return p > 1.0 ? 1.0 : p;
+	}
+
+	sigma = sqrt((double)n1 * n2 / 12.0 * ((n + 1) - ties / ((double)n * (n - 1))));
+	if (sigma == 0.0)
+		return 1.0;
+
+	/* continuity correction */
+	z = (fabs(u - mu) - 0.5) / sigma;
+	if (z < 0)
+		z = 0;
+	p = erfc(z / sqrt(2.0));
+	return p > 1.0 ? 1.0 : p;
+}
+
+/* computes into <lo> and <hi> the bootstrap confidence interval at level
+ * 1-alpha of the relative difference of the medians of <y> over <x>, in
+ * percent.
+ */
+static void bootstrap(const double *x, unsigned int n1, const double *y, unsigned int n2,
+                      double *lo, double *hi)
+{
+	double *rx, *ry, *d;
+	unsigned int b, i;
+
+	rx = calloc(n1, sizeof(*rx));
+	ry = calloc(n2, sizeof(*ry));
+	d  = calloc(arg_boot, sizeof(*d));
+	if (!rx || !ry || !d) {
+		*lo = *hi = NAN;
+		goto out;
+	}
+
+	for (b = 0; b < arg_boot; b++) {
+		double mx, my;
+
+		for (i = 0; i < n1; i++)
+			rx[i] = x[rnd32_range(n1)];
+		for (i = 0; i < n2; i++)
+			ry[i] = y[rnd32_range(n2)];
+		qsort(rx, n1, sizeof(double), cmp_double);
+		qsort(ry, n2, sizeof(double), cmp_double);
+		mx = median(rx, n1);
+		my = median(ry, n2);
+		d[b] = mx ? (my - mx) * 100.0 / mx : 0.0;
+	}
+	qsort(d, arg_boot, sizeof(double), cmp_double);
+	*lo = d[(unsigned int)(arg_boot * arg_alpha / 2.0)];
+	*hi = d[(unsigned int)(arg_boot * (1.0 - arg_alpha / 2.0)) - 1];
+ out:
+	free(rx); free(ry); free(d);
+}
+
+void usage(int ret)
+{
+	printf("usage: benchcmp [-h] [-l] [-a alpha] [-t threshold_pct] [-b boot_iter] before after\n"
+	       "  -l : lower values are better (e.g. latencies)\n"
+	       "  -a : significance level (default 0.05)\n"
+	       "  -t : regression threshold on the median in percent (default 2)\n"
+	       "  -b : number of bootstrap iterations (default 2000)\n"
+	       "Input files contain one '<config> <value>' sample per line.\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i, regressions = 0;
+	struct config *b, *a;
+	double mb, ma, delta, worse, p, lo, hi;
+	const char *verdict;
+
+	argc--; argv++;
+	while (argc > 0 && **argv == '-') {
+		if (!strcmp(*argv, "-a")) {
+			if (--argc < 0)
+				usage(2);
+			arg_alpha = atof(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(2);
+			arg_threshold = atof(*++argv);
+		}
+		else if (!strcmp(*argv, "-b")) {
+			if (--argc < 0)
+				usage(2);
+			arg_boot = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l"))
+			arg_lower = 1;
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(2);
+		argc--; argv++;
+	}
+
+	if (argc != 2 || arg_alpha <= 0.0 || arg_alpha >= 1.0 || arg_boot < 100)
+		usage(2);
+
+	if (load_results(argv[0], &before) < 0 || load_results(argv[1], &after) < 0)
+		exit(2);
+
+	printf("%-32s %4s %4s %14s %14s %8s %8s %18s  %s\n",
+	       "# config", "n1", "n2", "median1", "median2", "delta%", "p", "CI(delta%)", "verdict");
+
+	for (i = 0; i < before.nbcfg; i++) {
+		b = &before.cfg[i];
+		a = find_config(&after, b->name);
+		if (!a) {
+			printf("%-32s %4u %4s %14.6g %14s %8s %8s %18s  %s\n",
+			       b->name, b->nbval, "-", median(b->val, b->nbval), "-", "-", "-", "-", "missing");
+			continue;
+		}
+
+		mb = median(b->val, b->nbval);
+		ma = median(a->val, a->nbval);
+		delta = mb ? (ma - mb) * 100.0 / mb : 0.0;
+		worse = arg_lower ? delta : -delta;
+		p = mann_whitney(b->val, b->nbval, a->val, a->nbval);
+		bootstrap(b->val, b->nbval, a->val, a->nbval, &lo, &hi);
+
+		if (p >= arg_alpha)
+			verdict = "~";
+		else if (worse > arg_threshold) {
+			verdict = "REGRESSION";
+			regressions++;
+		}
+		else if (worse < -arg_threshold)
+			verdict = "improved";
+		else
+			verdict = "~ (below threshold)";
+
+		printf("%-32s %4u %4u %14.6g %14.6g %+8.2f %8.4f   [%+6.2f,%+6.2f]  %s\n",
+		       b->name, b->nbval, a->nbval, mb, ma, delta, p, lo, hi, verdict);
+	}
+
+	for (i = 0; i < after.nbcfg; i++) {
+		a = &after.cfg[i];
+		if (!find_config(&before, a->name))
+			printf("%-32s %4s %4u %14s %14.6g %8s %8s %18s  %s\n",
+			       a->name, "-", a->nbval, "-", median(a->val, a->nbval), "-", "-", "-", "new");
+	}
+
+	if (regressions)
+		printf("# %u regression(s) above %.2f%% at alpha=%.3f\n", regressions, arg_threshold, arg_alpha);
+
+	exit(regressions ? 1 : 0);
+}
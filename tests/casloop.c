@@ -0,0 +1,170 @@
+/*
+ * Contended CAS update loops benchmark -- 2026-10-17
+ *
+ * Threads repeatedly update a shared counter using a read-compute-CAS loop,
+ * either hand-written (reloading the value and retrying immediately), or with
+ * pl_update() which reuses the value returned by the CAS and backs off after
+ * failures. Two operations are measured: a max-update where each thread
+ * pushes increasing values, and a saturating add which stops at a limit. The
+ * final value is checked in both cases.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o casloop casloop.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <plock.h>
+
+#define MAXTHREADS 64
+
+int arg_mode = 1;
+int arg_threads = 4;
+unsigned long arg_loops = 1000000;
+unsigned long arg_limit = 0;
+
+static unsigned long counter __attribute__((aligned(64)));
+static volatile unsigned long step;
+static unsigned long cpu_ns[MAXTHREADS];
+static struct timeval start, stop;
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	unsigned long n, v, old, new;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; n < arg_loops; n++) {
+		switch (arg_mode) {
+		case 0: /* naive max */
+			v = n * arg_threads + thr;
+			do {
+				old = pl_load(&counter);
+				new = old > v ? old : v;
+			} while (new != old && pl_cmpxchg(&counter, old, new) != old);
+			break;
+		case 1: /* pl_update() max */
+			v = n * arg_threads + thr;
+			pl_update(&counter, old, old > v ? old : v);
+			break;
+		case 2: /* naive saturating add */
+			do {
+				old = pl_load(&counter);
+				new = old < arg_limit ? old + 1 : old;
+			} while (new != old && pl_cmpxchg(&counter, old, new) != old);
+			break;
+		case 3: /* pl_update() saturating add */
+			pl_update(&counter, old, old < arg_limit ? old + 1 : old);
+			break;
+		}
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: casloop [-h] [-m mode] [-t threads] [-l loops] [-s limit]\n"
+	       "Modes :\n"
+	       "  0 : max-update with a hand-written CAS loop\n"
+	       "  1 : max-update with pl_update()\n"
+	       "  2 : saturating add with a hand-written CAS loop\n"
+	       "  3 : saturating add with pl_update()\n"
+	       "The default saturation limit is never reached (threads*loops).\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, total, cpu, expected;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			arg_threads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-s")) {
+			if (--argc < 0)
+				usage(1);
+			arg_limit = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 3 || !arg_loops ||
+	    arg_threads < 1 || arg_threads > MAXTHREADS)
+		usage(1);
+
+	total = arg_threads * arg_loops;
+	if (!arg_limit)
+		arg_limit = total;
+
+	for (i = 0; i < arg_threads; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_threads; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	if (arg_mode <= 1)
+		expected = total - 1;
+	else
+		expected = total < arg_limit ? total : arg_limit;
+
+	if (counter != expected) {
+		fprintf(stderr, "Bad final value %lu, expected %lu!\n", counter, expected);
+		exit(1);
+	}
+
+	for (i = cpu = 0; i < arg_threads; i++)
+		cpu += cpu_ns[i] / 1000;
+
+	printf("mode: %d threads: %d updates: %lu time(ms): %lu rate(ups): %Lu, cpu(ms): %lu (%lu%%)\n",
+	       arg_mode, arg_threads, total, ms, total * 1000ULL / ms,
+	       cpu / 1000, cpu / 10 / ms);
+	exit(0);
+}
@@ -0,0 +1,218 @@
+/*
+ * Condition variable tester -- 2026-10-17
+ *
+ * Producers push integers into a bounded ring and consumers pop them, both
+ * waiting on a condition when the ring is full or empty respectively. The
+ * ring is protected either by a pthread mutex with two pthread condition
+ * variables, or by a plock held in W mode with two pl_cond. Every 64 items,
+ * the producers broadcast instead of signaling to exercise the requeue. The
+ * sum of all consumed values is checked at the end.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o condlock condlock.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pl-futex.h>
+
+#define MAXTHREADS 64
+#define RINGSIZE   16
+
+/* waiter bit used by pl_cond_wait(), one of the application bits */
+#define WBIT 1UL
+
+int arg_mode = 0;
+int arg_prod = 2;
+int arg_cons = 2;
+unsigned long arg_loops = 100000;
+
+static unsigned long ring[RINGSIZE];
+static unsigned int head, tail;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t not_full = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t not_empty = PTHREAD_COND_INITIALIZER;
+
+static unsigned long lock;
+static struct pl_cond pl_not_full = PL_COND_INITIALIZER;
+static struct pl_cond pl_not_empty = PL_COND_INITIALIZER;
+
+static volatile unsigned long step;
+static unsigned long sums[MAXTHREADS];
+static unsigned long cpu_ns[MAXTHREADS];
+static struct timeval start, stop;
+
+void *producer(void *arg)
+{
+	long thr = (long)arg;
+	unsigned long n;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 1; n <= arg_loops; n++) {
+		if (arg_mode == 0) {
+			pthread_mutex_lock(&mutex);
+			while (head - tail >= RINGSIZE)
+				pthread_cond_wait(&not_full, &mutex);
+			ring[head++ % RINGSIZE] = n;
+			if (n % 64)
+				pthread_cond_signal(&not_empty);
+			else
+				pthread_cond_broadcast(&not_empty);
+			pthread_mutex_unlock(&mutex);
+		}
+		else {
+			pl_take_w(&lock);
+			while (head - tail >= RINGSIZE)
+				pl_cond_wait_w(&pl_not_full, &lock, WBIT);
+			ring[head++ % RINGSIZE] = n;
+			if (n % 64)
+				pl_cond_signal(&pl_not_empty);
+			else
+				pl_cond_broadcast(&pl_not_empty);
+			pl_drop_w_wake(&lock, WBIT);
+		}
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void *consumer(void *arg)
+{
+	long thr = (long)arg;
+	unsigned long n, sum = 0;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	/* consumers share the produced items equally */
+	for (n = 0; n < arg_loops * arg_prod / arg_cons; n++) {
+		if (arg_mode == 0) {
+			pthread_mutex_lock(&mutex);
+			while (head == tail)
+				pthread_cond_wait(&not_empty, &mutex);
+			sum += ring[tail++ % RINGSIZE];
+			pthread_cond_signal(&not_full);
+			pthread_mutex_unlock(&mutex);
+		}
+		else {
+			pl_take_w(&lock);
+			while (head == tail)
+				pl_cond_wait_w(&pl_not_empty, &lock, WBIT);
+			sum += ring[tail++ % RINGSIZE];
+			pl_cond_signal(&pl_not_full);
+			pl_drop_w_wake(&lock, WBIT);
+		}
+	}
+
+	sums[thr] = sum;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: condlock [-h] [-m mode] [-p producers] [-c consumers] [-l loops]\n"
+	       "Modes :\n"
+	       "  0 : pthread_mutex + pthread_cond\n"
+	       "  1 : plock W + pl_cond\n"
+	       "The number of producers must be a multiple of the number of consumers.\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, total, expected, cpu;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-p")) {
+			if (--argc < 0)
+				usage(1);
+			arg_prod = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-c")) {
+			if (--argc < 0)
+				usage(1);
+			arg_cons = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 1 || !arg_loops ||
+	    arg_prod < 1 || arg_cons < 1 || arg_prod + arg_cons > MAXTHREADS ||
+	    (arg_loops * arg_prod) % arg_cons)
+		usage(1);
+
+	for (i = 0; i < arg_prod + arg_cons; i++) {
+		if (pthread_create(&thr[i], NULL, (i < arg_prod) ? producer : consumer, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_prod + arg_cons; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	if (lock & ~WBIT) {
+		fprintf(stderr, "Lock left locked: %#lx!\n", lock);
+		exit(1);
+	}
+
+	expected = arg_prod * (arg_loops * (arg_loops + 1) / 2);
+	for (i = total = cpu = 0; i < arg_prod + arg_cons; i++) {
+		total += sums[i];
+		cpu += cpu_ns[i] / 1000;
+	}
+
+	if (total != expected || head != tail) {
+		fprintf(stderr, "Bad total %lu, expected %lu (head=%u tail=%u)!\n", total, expected, head, tail);
+		exit(1);
+	}
+
+	printf("mode: %d producers: %d consumers: %d items: %lu time(ms): %lu rate(ips): %Lu, cpu(ms): %lu (%lu%%)\n",
+	       arg_mode, arg_prod, arg_cons, arg_prod * arg_loops, ms, arg_prod * arg_loops * 1000ULL / ms,
+	       cpu / 1000, cpu / 10 / ms);
+	exit(0);
+}
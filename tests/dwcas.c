@@ -0,0 +1,197 @@
+/*
+ * Double-word atomic operations benchmark -- 2026-10-17
+ *
+ * Threads operate on a pair of longs {n, ~n}, shared by all threads or
+ * private to each thread, in order to compare the cost of the double-word
+ * operations with the single-word CAS:
+ *   - mode 0 increments a single long with a pl_cmpxchg() loop ;
+ *   - mode 1 increments the pair with a pl_cmpxchg_dw() loop ;
+ *   - mode 2 reads the pair with pl_load_dw(), while thread 0 keeps storing
+ *     new values with pl_store_dw() ;
+ *   - mode 3 replaces the pair with pl_xchg_dw().
+ * Every value read is checked for consistency of both halves, and the final
+ * count is checked in modes 0 and 1.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o dwcas dwcas.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <plock.h>
+
+#define MAXTHREADS 64
+
+struct pair {
+	unsigned long n;
+	unsigned long inv;
+} __attribute__((aligned(2 * sizeof(long))));
+
+struct slot {
+	struct pair p;
+} __attribute__((aligned(64)));
+
+int arg_mode = 1;
+int arg_threads = 4;
+int arg_private = 0;
+unsigned long arg_loops = 1000000;
+
+static struct slot slots[MAXTHREADS];
+static volatile unsigned long step;
+static unsigned long errors[MAXTHREADS];
+static unsigned long cpu_ns[MAXTHREADS];
+static struct timeval start, stop;
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	struct pair *p = &slots[arg_private ? thr : 0].p;
+	struct pair old, new;
+	unsigned long n, prev;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; n < arg_loops; n++) {
+		switch (arg_mode) {
+		case 0:
+			prev = pl_load(&p->n);
+			while (pl_cmpxchg(&p->n, prev, prev + 1) != prev)
+				prev = pl_load(&p->n);
+			break;
+		case 1:
+			old.n = pl_load(&p->n);
+			old.inv = pl_load(&p->inv);
+			do {
+				new.n = old.n + 1;
+				new.inv = ~new.n;
+			} while (!pl_cmpxchg_dw(p, &old, &new));
+			if (old.inv != ~old.n)
+				errors[thr]++;
+			break;
+		case 2:
+			if (thr == 0) {
+				new.n = n;
+				new.inv = ~n;
+				pl_store_dw(p, &new);
+			}
+			else {
+				pl_load_dw(p, &old);
+				if (old.inv != ~old.n)
+					errors[thr]++;
+			}
+			break;
+		case 3:
+			new.n = n;
+			new.inv = ~n;
+			pl_xchg_dw(p, &new, &old);
+			if (old.inv != ~old.n)
+				errors[thr]++;
+			break;
+		}
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: dwcas [-h] [-m mode] [-t threads] [-l loops] [-p]\n"
+	       "Modes :\n"
+	       "  0 : pl_cmpxchg() increment of a long\n"
+	       "  1 : pl_cmpxchg_dw() increment of a pair of longs\n"
+	       "  2 : pl_load_dw() of a pair of longs updated by thread 0\n"
+	       "  3 : pl_xchg_dw() of a pair of longs\n"
+	       "  -p : use one private pair per thread instead of a shared one\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, total, cpu, errs, count;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			arg_threads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-p"))
+			arg_private = 1;
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 3 || !arg_loops ||
+	    arg_threads < 1 || arg_threads > MAXTHREADS)
+		usage(1);
+
+	for (i = 0; i < MAXTHREADS; i++)
+		slots[i].p.inv = ~0UL;
+
+	for (i = 0; i < arg_threads; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_threads; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	total = arg_threads * arg_loops;
+	for (i = errs = cpu = count = 0; i < arg_threads; i++) {
+		errs += errors[i];
+		cpu += cpu_ns[i] / 1000;
+		if (i == 0 || arg_private)
+			count += slots[i].p.n;
+	}
+
+	if (errs || (arg_mode <= 1 && count != total)) {
+		fprintf(stderr, "Bad result: %lu inconsistent values, count %lu, expected %lu!\n",
+			errs, count, total);
+		exit(1);
+	}
+
+	printf("mode: %d threads: %d private: %d ops: %lu time(ms): %lu rate(ops): %Lu, cpu(ms): %lu (%lu%%)\n",
+	       arg_mode, arg_threads, arg_private, total, ms, total * 1000ULL / ms,
+	       cpu / 1000, cpu / 10 / ms);
+	exit(0);
+}
@@ -0,0 +1,301 @@
+/*
+ * Epoch-based reclamation tester -- 2026-10-17
+ *
+ * A table of slots points to nodes which writers keep replacing under a W
+ * lock, while readers look them up. Readers either take the R lock, in which
+ * case writers free the old nodes immediately, or only enter an epoch critical
+ * section without any lock, in which case writers retire the old nodes which
+ * are freed later. Freed nodes are poisoned before being released, and the
+ * readers check each node they visit to detect any use after free. Before
+ * starting, a sequence where a writer retires a node while a reader entered
+ * at a later epoch is run from a single thread to verify that the node is
+ * only freed after the reader leaves.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o ebrbench ebrbench.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pl-ebr.h>
+
+#define MAXTHREADS 64
+#define MAXSLOTS   65536
+
+#define NODE_LIVE  0x4c495645U
+#define NODE_DEAD  0xdeaddeadU
+
+struct node {
+	struct pl_ebr_node ebr;
+	unsigned int key;
+	unsigned int magic;
+};
+
+int arg_mode = 0;
+int arg_readers = 3;
+int arg_writers = 1;
+int arg_slots = 1024;
+unsigned long arg_loops = 1000000;
+
+static struct node *slots[MAXSLOTS];
+static unsigned long lock;
+static struct pl_ebr ebr;
+static struct pl_ebr_thread ebr_th[MAXTHREADS];
+static unsigned long lookups[MAXTHREADS];
+static unsigned long updates[MAXTHREADS];
+static unsigned long freed;
+static unsigned int readers_left;
+static volatile unsigned long step;
+static struct timeval start, stop;
+
+static void free_node(struct pl_ebr_node *n)
+{
+	struct node *node = (struct node *)n;
+
+	node->magic = NODE_DEAD;
+	pl_inc_noret(&freed);
+	free(node);
+}
+
+static struct node *new_node(unsigned int key)
+{
+	struct node *node = malloc(sizeof(*node));
+
+	if (!node) {
+		perror("malloc");
+		exit(1);
+	}
+	node->key = key;
+	node->magic = NODE_LIVE;
+	return node;
+}
+
+static inline unsigned int rnd32(unsigned int *state)
+{
+	unsigned int x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+void *reader(void *arg)
+{
+	long thr = (long)arg;
+	unsigned int rnd = thr * 2654435761U + 1;
+	struct node *node;
+	unsigned long n;
+	unsigned int i;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; n < arg_loops; n++) {
+		i = rnd32(&rnd) % arg_slots;
+
+		if (arg_mode == 0)
+			pl_take_r(&lock);
+		else
+			pl_ebr_enter(&ebr, thr);
+
+		node = pl_load(&slots[i]);
+		if (node->key != i || node->magic != NODE_LIVE) {
+			fprintf(stderr, "Thread %ld found a freed node in slot %u (key=%u magic=%#x)!\n",
+			        thr, i, node->key, node->magic);
+			exit(1);
+		}
+
+		if (arg_mode == 0)
+			pl_drop_r(&lock);
+		else
+			pl_ebr_leave(&ebr, thr);
+	}
+
+	lookups[thr] = n;
+	pl_dec_noret(&readers_left);
+	return NULL;
+}
+
+void *writer(void *arg)
+{
+	long thr = (long)arg;
+	unsigned int rnd = thr * 2654435761U + 1;
+	struct node *node, *old;
+	unsigned long n;
+	unsigned int i;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; pl_load(&readers_left); n++) {
+		i = rnd32(&rnd) % arg_slots;
+		node = new_node(i);
+
+		if (arg_mode == 1)
+			pl_ebr_enter(&ebr, thr);
+
+		pl_take_w(&lock);
+		old = slots[i];
+		pl_store(&slots[i], node);
+		pl_drop_w(&lock);
+
+		if (arg_mode == 0)
+			free_node(&old->ebr);
+		else {
+			pl_ebr_retire(&ebr, thr, &old->ebr, free_node);
+			pl_ebr_leave(&ebr, thr);
+		}
+	}
+
+	/* the other writers may still be retiring nodes, so let's only
+	 * reclaim what is already possible.
+	 */
+	if (arg_mode == 1)
+		pl_ebr_reclaim(&ebr, thr);
+
+	updates[thr] = n;
+	return NULL;
+}
+
+/* free callback for check_sequence(), which only counts the calls */
+static unsigned int seq_freed;
+static void seq_free(struct pl_ebr_node *n)
+{
+	(void)n;
+	seq_freed++;
+}
+
+/* From a single thread, runs a writer (0) and a reader (1) through a sequence
+ * where the writer retires a node while its announced epoch is behind the
+ * global one and a reader which may have found the node entered at the global
+ * one. The node must not be freed before the reader leaves. Returns non-zero
+ * on success.
+ */
+static int check_sequence(void)
+{
+	struct pl_ebr e;
+	struct pl_ebr_thread th[2];
+	struct pl_ebr_node x;
+
+	pl_ebr_init(&e, th, 2);
+	pl_ebr_enter(&e, 0);            /* W enters at 2 */
+	pl_ebr_advance(&e);             /* 2 -> 4 */
+	pl_ebr_enter(&e, 1);            /* R enters at 4, may find x */
+	pl_ebr_retire(&e, 0, &x, seq_free);
+	pl_ebr_leave(&e, 0);
+	pl_ebr_advance(&e);             /* 4 -> 6 */
+	pl_ebr_enter(&e, 0);            /* W enters at 6 */
+	pl_ebr_leave(&e, 0);
+	if (seq_freed || pl_ebr_advance(&e))
+		return 0;               /* freed under R, or R ignored */
+
+	pl_ebr_leave(&e, 1);
+	pl_ebr_advance(&e);             /* 6 -> 8 */
+	pl_ebr_enter(&e, 0);            /* W enters at 8, x is safe */
+	pl_ebr_leave(&e, 0);
+	return seq_freed == 1;
+}
+
+void usage(int ret)
+{
+	printf("usage: ebrbench [-h] [-m mode] [-r readers] [-w writers] [-s slots] [-l loops]\n"
+	       "Modes :\n"
+	       "  0 : readers take the R lock, writers free immediately\n"
+	       "  1 : readers enter an epoch, writers retire the nodes\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, reads, writes;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-r")) {
+			if (--argc < 0)
+				usage(1);
+			arg_readers = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-w")) {
+			if (--argc < 0)
+				usage(1);
+			arg_writers = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-s")) {
+			if (--argc < 0)
+				usage(1);
+			arg_slots = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 1 || !arg_loops ||
+	    arg_readers < 1 || arg_writers < 0 || arg_readers + arg_writers > MAXTHREADS ||
+	    arg_slots < 1 || arg_slots > MAXSLOTS)
+		usage(1);
+
+	if (!check_sequence()) {
+		fprintf(stderr, "Retired node freed too early or too late!\n");
+		exit(1);
+	}
+
+	for (i = 0; i < arg_slots; i++)
+		slots[i] = new_node(i);
+
+	pl_ebr_init(&ebr, ebr_th, arg_readers + arg_writers);
+	readers_left = arg_readers;
+
+	for (i = 0; i < arg_readers + arg_writers; i++) {
+		if (pthread_create(&thr[i], NULL, (i < arg_readers) ? reader : writer, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_readers + arg_writers; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	for (i = reads = writes = 0; i < arg_readers + arg_writers; i++) {
+		reads += lookups[i];
+		writes += updates[i];
+	}
+
+	printf("mode: %d readers: %d writers: %d slots: %d lookups: %lu updates: %lu freed: %lu time(ms): %lu rate(lps): %Lu\n",
+	       arg_mode, arg_readers, arg_writers, arg_slots, reads, writes, freed, ms, reads * 1000ULL / ms);
+	exit(0);
+}
@@ -0,0 +1,208 @@
+/*
+ * Eventcount tester -- 2026-10-17
+ *
+ * Producers publish items by atomically incrementing a counter, and consumers
+ * take them one at a time by atomically decrementing it when not zero. When
+ * there is nothing to consume, the consumers either poll the counter with CPU
+ * pauses, or wait on an eventcount notified by the producers. Producers may
+ * be slowed down (-d) so that the consumers are often idle, which shows the
+ * CPU wasted by polling. The number of consumed items is checked at the end.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o eventcount eventcount.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pl-futex.h>
+
+#define MAXTHREADS 64
+
+int arg_mode = 0;
+int arg_prod = 1;
+int arg_cons = 2;
+unsigned long arg_loops = 100000;
+unsigned int arg_delay = 0;
+
+static unsigned int items;
+static unsigned int done;
+static struct pl_eventcount ec = PL_EVENTCOUNT_INITIALIZER;
+static unsigned long consumed[MAXTHREADS];
+static volatile unsigned long step;
+static unsigned long cpu_ns[MAXTHREADS];
+static struct timeval start, stop;
+
+/* takes one item if available and returns non-zero, otherwise zero */
+static inline int take_one(void)
+{
+	unsigned int curr = pl_deref_int(&items);
+
+	while (curr) {
+		unsigned int prev = pl_cmpxchg(&items, curr, curr - 1);
+		if (prev == curr)
+			return 1;
+		curr = prev;
+	}
+	return 0;
+}
+
+void *producer(void *arg)
+{
+	long thr = (long)arg;
+	unsigned long n;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; n < arg_loops; n++) {
+		if (arg_delay)
+			usleep(arg_delay);
+		pl_inc_noret(&items);
+		if (arg_mode == 1)
+			pl_ec_notify_ato(&ec);
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void *consumer(void *arg)
+{
+	long thr = (long)arg;
+	unsigned long count = 0;
+	unsigned int key;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	while (1) {
+		if (take_one()) {
+			count++;
+			continue;
+		}
+		if (pl_load(&done) && !pl_load(&items))
+			break;
+
+		if (arg_mode == 0) {
+			pl_cpu_relax();
+			continue;
+		}
+
+		key = pl_ec_prepare_wait(&ec);
+		if (pl_load(&items) || pl_load(&done))
+			pl_ec_cancel_wait(&ec);
+		else
+			pl_ec_commit_wait(&ec, key);
+	}
+
+	consumed[thr] = count;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: eventcount [-h] [-m mode] [-p producers] [-c consumers] [-l loops] [-d delay_us]\n"
+	       "Modes :\n"
+	       "  0 : consumers poll the counter\n"
+	       "  1 : consumers wait on an eventcount\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, total, cpu;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-p")) {
+			if (--argc < 0)
+				usage(1);
+			arg_prod = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-c")) {
+			if (--argc < 0)
+				usage(1);
+			arg_cons = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-d")) {
+			if (--argc < 0)
+				usage(1);
+			arg_delay = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 1 || !arg_loops ||
+	    arg_prod < 1 || arg_cons < 1 || arg_prod + arg_cons > MAXTHREADS)
+		usage(1);
+
+	for (i = 0; i < arg_prod + arg_cons; i++) {
+		if (pthread_create(&thr[i], NULL, (i < arg_prod) ? producer : consumer, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_prod; i++)
+		pthread_join(thr[i], NULL);
+
+	pl_store(&done, 1);
+	pl_ec_notify_all(&ec);
+
+	for (; i < arg_prod + arg_cons; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	for (i = total = cpu = 0; i < arg_prod + arg_cons; i++) {
+		total += consumed[i];
+		cpu += cpu_ns[i] / 1000;
+	}
+
+	if (total != arg_prod * arg_loops || items) {
+		fprintf(stderr, "Bad consumed count %lu, expected %lu (left %u)!\n", total, arg_prod * arg_loops, items);
+		exit(1);
+	}
+
+	printf("mode: %d producers: %d consumers: %d items: %lu time(ms): %lu rate(ips): %Lu, cpu(ms): %lu (%lu%%)\n",
+	       arg_mode, arg_prod, arg_cons, total, ms, total * 1000ULL / ms,
+	       cpu / 1000, cpu / 10 / ms);
+	exit(0);
+}
@@ -0,0 +1,249 @@
+/*
+ * Frequency counter tester -- 2026-10-17
+ *
+ * Threads count events into a single frequency counter, using the date of a
+ * logical clock advanced by the main thread. The counter is either updated
+ * under a plock W lock, or with pl_freq_update(). Each thread also counts its
+ * events per clock tick in a private array so that at the end, the counts of
+ * the last two periods can be compared with the counter's. Since an update
+ * racing with a rotation may be accounted to either period, a difference of
+ * one event per thread and period boundary is tolerated. The main thread also
+ * reads the rate while the counter is being updated. Before starting, a
+ * counter starting from its initializer at a large date is verified to rotate.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o freqctr freqctr.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pl-freq.h>
+
+#define MAXTHREADS 64
+#define MAXTICKS   100000
+
+int arg_mode = 1;
+int arg_threads = 4;
+unsigned int arg_period = 100;
+unsigned int arg_tickus = 100;
+unsigned long arg_loops = 1000000;
+
+static struct pl_freq_ctr ctr = PL_FREQ_CTR_INITIALIZER;
+static unsigned long lock;
+static unsigned int now_tick = 1; /* a period cannot start at 0, see pl-freq.h */
+
+static unsigned int *events[MAXTHREADS];
+static volatile unsigned long step;
+static unsigned long running;
+static unsigned long cpu_ns[MAXTHREADS];
+static struct timeval start, stop;
+
+/* the same as pl_freq_update() under a lock */
+static void locked_update(struct pl_freq_ctr *ctr, unsigned int period, unsigned int now, unsigned int inc)
+{
+	unsigned int elapsed;
+
+	pl_take_w(&lock);
+	elapsed = pl_freq_elapsed(ctr->tick, now);
+	if (!ctr->tick || (elapsed >= period && !pl_freq_early(elapsed, period))) {
+		if (ctr->tick && elapsed < 2 * period) {
+			ctr->prev = ctr->curr;
+			ctr->tick += period << 1;
+		}
+		else {
+			ctr->prev = 0;
+			ctr->tick = now << 1;
+		}
+		if (!ctr->tick)
+			ctr->tick = 2;
+		ctr->curr = 0;
+	}
+	ctr->curr += inc;
+	pl_drop_w(&lock);
+}
+
+/* From a single thread, counts 10 events per period of 10 ticks over 10
+ * periods into a counter starting from PL_FREQ_CTR_INITIALIZER at a large
+ * date, and verifies that the rate remains around 10. Returns non-zero on
+ * success.
+ */
+static int check_initializer(void)
+{
+	struct pl_freq_ctr c = PL_FREQ_CTR_INITIALIZER;
+	unsigned int now = 0x50000000U;
+	unsigned int t, rate;
+
+	for (t = 0; t < 100; t++)
+		pl_freq_update(&c, 10, now + t, 1);
+	rate = pl_freq_read(&c, 10, now + t - 1);
+	return rate >= 9 && rate <= 11;
+}
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	unsigned int *ev = events[thr];
+	unsigned long n;
+	unsigned int now;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; n < arg_loops; n++) {
+		now = pl_load(&now_tick);
+		if (arg_mode == 0)
+			locked_update(&ctr, arg_period, now, 1);
+		else
+			pl_freq_update(&ctr, arg_period, now, 1);
+		ev[now]++;
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	pl_dec_noret(&running);
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: freqctr [-h] [-m mode] [-t threads] [-l loops] [-p period] [-u tick_us]\n"
+	       "Modes :\n"
+	       "  0 : counter updated under a plock\n"
+	       "  1 : pl_freq_update()\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, total, cpu, curr, prev, reads;
+	unsigned int now, tick, rate, maxrate;
+	long i, t;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			arg_threads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-p")) {
+			if (--argc < 0)
+				usage(1);
+			arg_period = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-u")) {
+			if (--argc < 0)
+				usage(1);
+			arg_tickus = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 1 || !arg_loops || !arg_period ||
+	    arg_threads < 1 || arg_threads > MAXTHREADS)
+		usage(1);
+
+	if (!check_initializer()) {
+		fprintf(stderr, "Counter started from the initializer does not rotate!\n");
+		exit(1);
+	}
+
+	for (i = 0; i < arg_threads; i++) {
+		events[i] = calloc(MAXTICKS, sizeof(*events[i]));
+		if (!events[i]) {
+			perror("calloc");
+			exit(1);
+		}
+	}
+
+	running = arg_threads;
+	for (i = 0; i < arg_threads; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	/* advance the clock while the threads are running, and sample the
+	 * rate, which may never exceed the number of events.
+	 */
+	maxrate = reads = 0;
+	while (pl_load(&running)) {
+		usleep(arg_tickus);
+		if (now_tick < MAXTICKS - 1)
+			pl_inc_noret(&now_tick);
+		rate = pl_freq_read(&ctr, arg_period, now_tick);
+		if (rate > maxrate)
+			maxrate = rate;
+		reads++;
+	}
+
+	for (i = 0; i < arg_threads; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	/* count the events per period as seen by the threads, relative to the
+	 * start of the counter's current period.
+	 */
+	tick = ctr.tick >> 1;
+	now = now_tick;
+	total = curr = prev = 0;
+	for (i = 0; i < arg_threads; i++) {
+		for (t = 0; t <= now; t++) {
+			total += events[i][t];
+			if (t >= tick)
+				curr += events[i][t];
+			else if (t + arg_period >= tick)
+				prev += events[i][t];
+		}
+	}
+
+	if (ctr.tick & 1 || total != arg_threads * arg_loops ||
+	    labs((long)curr - (long)ctr.curr) > arg_threads ||
+	    labs((long)prev - (long)ctr.prev) > 2 * arg_threads || maxrate > total) {
+		fprintf(stderr, "Bad counter: tick=%#x curr=%u prev=%u, expected curr=%lu prev=%lu, max rate %u\n",
+			ctr.tick, ctr.curr, ctr.prev, curr, prev, maxrate);
+		exit(1);
+	}
+
+	for (i = cpu = 0; i < arg_threads; i++)
+		cpu += cpu_ns[i] / 1000;
+
+	printf("mode: %d threads: %d events: %lu ticks: %u time(ms): %lu rate(eps): %Lu, cpu(ms): %lu (%lu%%) reads: %lu\n",
+	       arg_mode, arg_threads, total, now, ms, total * 1000ULL / ms,
+	       cpu / 1000, cpu / 10 / ms, reads);
+	exit(0);
+}
@@ -0,0 +1,300 @@
+/*
+ * C++ lock guards tester -- 2026-10-17
+ *
+ * Threads perform a mix of operations on a shared pair of counters which must
+ * always be equal, either using the plock.h macros or the plock.hpp guards,
+ * on a 64-bit lock or on a 32-bit one :
+ *   - 4/8 : R, check the counters ;
+ *   - 1/8 : W, increment the counters ;
+ *   - 1/8 : S, check, S->W, increment, W->R, check ;
+ *   - 1/8 : R, check, try R->W, increment on success ;
+ *   - 1/8 : A, increment a private counter.
+ * At the end, the counters must match the number of writes reported by the
+ * threads. Both implementations are expected to perform the same, since the
+ * guards must compile to the same code as the macros.
+ *
+ * Building with -DSHOW_ILLEGAL adds transitions which must not compile : an
+ * S->W upgrade without consuming the S guard, and R->W using pl_stow().
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   g++ -I.. -O2 -fomit-frame-pointer -s -o guardlock guardlock.cc -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <plock.hpp>
+
+/* the macros are also used directly below, see plock.hpp */
+#pragma GCC diagnostic ignored "-Wregister"
+#pragma GCC diagnostic ignored "-Wwrite-strings"
+
+#define MAXTHREADS 64
+
+int arg_mode = 1;
+int arg_threads = 4;
+int arg_int = 0;
+unsigned long arg_loops = 1000000;
+
+static struct {
+	unsigned long a;
+	unsigned long b;
+} data;
+
+static struct {
+	unsigned long v;
+} __attribute__((aligned(64))) slot[MAXTHREADS];
+
+static unsigned long lock64 __attribute__((aligned(64)));
+static unsigned int  lock32 __attribute__((aligned(64)));
+static volatile unsigned long step;
+static unsigned long errors[MAXTHREADS];
+static unsigned long writes[MAXTHREADS];
+static unsigned long cpu_ns[MAXTHREADS];
+static struct timeval start, stop;
+
+#if defined(SHOW_ILLEGAL)
+void illegal()
+{
+	plock::seek_guard<unsigned long> s(lock64);
+	plock::write_guard<unsigned long> w = s.stow();   /* S guard not consumed */
+
+	plock::read_guard<unsigned long> r(lock64);
+	plock::write_guard<unsigned long> w2 = std::move(r).stow(); /* no R->W */
+}
+#endif
+
+static inline void check(long thr)
+{
+	if (data.a != data.b)
+		errors[thr]++;
+}
+
+static inline void update(long thr)
+{
+	data.a++;
+	data.b++;
+	writes[thr]++;
+}
+
+/* one operation using the macros */
+template <typename T>
+static inline void with_macros(T *lock, long thr, unsigned long n)
+{
+	switch (n & 7) {
+	case 4:
+		pl_take_w(lock);
+		update(thr);
+		pl_drop_w(lock);
+		break;
+	case 5:
+		pl_take_s(lock);
+		check(thr);
+		pl_stow(lock);
+		update(thr);
+		pl_wtor(lock);
+		check(thr);
+		pl_drop_r(lock);
+		break;
+	case 6:
+		pl_take_r(lock);
+		check(thr);
+		if (pl_try_rtow(lock)) {
+			update(thr);
+			pl_drop_w(lock);
+		}
+		else
+			pl_drop_r(lock);
+		break;
+	case 7:
+		pl_take_a(lock);
+		slot[thr].v++;
+		pl_drop_a(lock);
+		break;
+	default:
+		pl_take_r(lock);
+		check(thr);
+		pl_drop_r(lock);
+		break;
+	}
+}
+
+/* the same operation using the guards */
+template <typename T>
+static inline void with_guards(T *lock, long thr, unsigned long n)
+{
+	switch (n & 7) {
+	case 4: {
+		plock::write_guard<T> w(*lock);
+		update(thr);
+		break;
+	}
+	case 5: {
+		plock::seek_guard<T> s(*lock);
+		check(thr);
+		plock::write_guard<T> w = std::move(s).stow();
+		update(thr);
+		plock::read_guard<T> r = std::move(w).wtor();
+		check(thr);
+		break;
+	}
+	case 6: {
+		plock::read_guard<T> r(*lock);
+		check(thr);
+		if (plock::write_guard<T> w = r.try_rtow())
+			update(thr);
+		break;
+	}
+	case 7: {
+		plock::atomic_guard<T> a(*lock);
+		slot[thr].v++;
+		break;
+	}
+	default: {
+		plock::read_guard<T> r(*lock);
+		check(thr);
+		break;
+	}
+	}
+}
+
+template <typename T>
+static void run(T *lock, long thr)
+{
+	unsigned long n;
+
+	for (n = thr; n < arg_loops + thr; n++) {
+		if (arg_mode == 0)
+			with_macros(lock, thr, n);
+		else
+			with_guards(lock, thr, n);
+	}
+}
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	if (arg_int)
+		run(&lock32, thr);
+	else
+		run(&lock64, thr);
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+/* unlocking empty guards must do nothing. Returns non-zero on success. */
+template <typename T>
+static int check_unlock(T *lock)
+{
+	plock::write_guard<T> w(*lock);
+	plock::read_guard<T> r = std::move(w).wtor();
+
+	w.unlock();                     /* moved from */
+	r.unlock();
+	r.unlock();                     /* already unlocked */
+	return !*lock && !r && !w;
+}
+
+void usage(int ret)
+{
+	printf("usage: guardlock [-h] [-m mode] [-t threads] [-l loops] [-i]\n"
+	       "Modes :\n"
+	       "  0 : plock.h macros\n"
+	       "  1 : plock.hpp guards\n"
+	       "  -i : use a 32-bit lock instead of a long\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, total, cpu, errs, wr;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			arg_threads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-i"))
+			arg_int = 1;
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 1 || !arg_loops ||
+	    arg_threads < 1 || arg_threads > MAXTHREADS)
+		usage(1);
+
+	if (!check_unlock(&lock64) || !check_unlock(&lock32)) {
+		fprintf(stderr, "Unlocking empty guards failed!\n");
+		exit(1);
+	}
+
+	for (i = 0; i < arg_threads; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_threads; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	for (i = errs = wr = cpu = 0; i < arg_threads; i++) {
+		errs += errors[i];
+		wr += writes[i];
+		cpu += cpu_ns[i] / 1000;
+	}
+
+	if (errs || data.a != wr || data.b != wr || lock64 || lock32) {
+		fprintf(stderr, "Bad result: %lu inconsistencies, a=%lu b=%lu writes=%lu lock=%#lx/%#x!\n",
+			errs, data.a, data.b, wr, lock64, lock32);
+		exit(1);
+	}
+
+	total = arg_threads * arg_loops;
+	printf("mode: %d threads: %d lock: %d bits loops: %lu writes: %lu time(ms): %lu rate(lps): %Lu, cpu(ms): %lu (%lu%%)\n",
+	       arg_mode, arg_threads, arg_int ? 32 : 64, total, wr, ms, total * 1000ULL / ms,
+	       cpu / 1000, cpu / 10 / ms);
+	exit(0);
+}
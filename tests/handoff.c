@@ -0,0 +1,147 @@
+/*
+ * Handoff notification tester -- 2026-10-17
+ *
+ * Two threads pass a token to each other through a shared word : each one
+ * waits for the word to change to its turn, optionally pretends to work for
+ * some time (-d, in microseconds), then hands the token over. The waiting is
+ * performed either by spinning in pl_wait_new_long() or by spinning briefly
+ * then sleeping in pl_sleep_new_long() with pl_notify_long() to hand over.
+ * The number of handoffs per second and the CPU time consumed by both threads
+ * compared to the elapsed time are reported. The waiter bit is the topmost bit
+ * of the word so that on 64-bit platforms the futex is on the upper half while
+ * the token changes the lower half.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o handoff handoff.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pl-futex.h>
+
+#define WBIT (1UL << (sizeof(long) * 8 - 1))
+
+int arg_mode = 0;
+unsigned long arg_loops = 100000;
+unsigned int arg_delay = 0;
+
+static unsigned long word;
+static volatile unsigned long step;
+static unsigned long cpu_ns[2];
+static struct timeval start, stop;
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	unsigned long v = 0, n;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = thr; n < 2 * arg_loops; n += 2) {
+		/* wait for our turn : the token value is n */
+		while ((v & ~WBIT) != n) {
+			if (arg_mode == 0)
+				v = pl_wait_new_long(&word, v);
+			else
+				v = pl_sleep_new_long(&word, v, WBIT);
+		}
+
+		if (arg_delay)
+			usleep(arg_delay);
+
+		/* hand over to the other thread */
+		if (arg_mode == 0)
+			pl_store(&word, n + 1);
+		else
+			pl_notify_long(&word, n + 1, WBIT);
+		v = n + 1;
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: handoff [-h] [-m mode] [-l loops] [-d delay_us]\n"
+	       "Modes :\n"
+	       "  0 : spin using pl_wait_new_long()\n"
+	       "  1 : spin then sleep using pl_sleep_new_long() / pl_notify_long()\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[2];
+	unsigned long ms;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-d")) {
+			if (--argc < 0)
+				usage(1);
+			arg_delay = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 1 || !arg_loops)
+		usage(1);
+
+	for (i = 0; i < 2; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < 2; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	if ((word & ~WBIT) != 2 * arg_loops) {
+		fprintf(stderr, "Bad final value %#lx, expected %#lx!\n", word, 2 * arg_loops);
+		exit(1);
+	}
+
+	printf("mode: %d handoffs: %lu time(ms): %lu rate(lps): %Lu, cpu(ms): %lu (%lu%%)\n",
+	       arg_mode, 2 * arg_loops, ms, 2 * arg_loops * 1000ULL / ms,
+	       (unsigned long)((cpu_ns[0] + cpu_ns[1]) / 1000000),
+	       (unsigned long)((cpu_ns[0] + cpu_ns[1]) / 10000 / ms));
+	exit(0);
+}
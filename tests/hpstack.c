@@ -0,0 +1,246 @@
+/*
+ * Hazard pointers tester -- 2026-10-17
+ *
+ * Threads repeatedly push a new node to a shared stack and pop one, which is
+ * then freed. The stack is either protected by a plock taken in W mode, or is
+ * a lock-free Treiber stack whose popped nodes are protected by hazard
+ * pointers during the pop and retired afterwards, with regular or asymmetric
+ * (membarrier-based) barriers. Freed nodes are poisoned before being
+ * released, and the poppers check each node to detect any use after free.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o hpstack hpstack.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pl-hazard.h>
+
+#define MAXTHREADS 64
+
+#define NODE_LIVE  0x4c495645U
+#define NODE_DEAD  0xdeaddeadU
+
+/* the hazard node is deliberately not the first member */
+struct node {
+	struct node *next;
+	unsigned int magic;
+	struct pl_hp_node hp;
+};
+
+int arg_mode = 0;
+int arg_threads = 4;
+unsigned long arg_loops = 1000000;
+unsigned int arg_prefill = 64;
+
+static struct node *top;
+static unsigned long lock;
+static struct pl_hp hp;
+static struct pl_hp_thread hp_th[MAXTHREADS];
+static unsigned long pops[MAXTHREADS];
+static volatile unsigned long step;
+static unsigned long cpu_ns[MAXTHREADS];
+static struct timeval start, stop;
+
+static void free_node(struct pl_hp_node *n)
+{
+	struct node *node = (struct node *)((char *)n - offsetof(struct node, hp));
+
+	node->magic = NODE_DEAD;
+	free(node);
+}
+
+static struct node *new_node(void)
+{
+	struct node *node = malloc(sizeof(*node));
+
+	if (!node) {
+		perror("malloc");
+		exit(1);
+	}
+	node->magic = NODE_LIVE;
+	return node;
+}
+
+static void push(struct node *node)
+{
+	struct node *curr, *prev;
+
+	if (arg_mode == 0) {
+		pl_take_w(&lock);
+		node->next = top;
+		top = node;
+		pl_drop_w(&lock);
+		return;
+	}
+
+	curr = pl_load(&top);
+	do {
+		node->next = curr;
+		prev = curr;
+		curr = pl_cmpxchg(&top, prev, node);
+	} while (curr != prev);
+}
+
+static struct node *pop(long thr)
+{
+	struct node *node, *next;
+
+	if (arg_mode == 0) {
+		pl_take_w(&lock);
+		node = top;
+		if (node)
+			top = node->next;
+		pl_drop_w(&lock);
+		return node;
+	}
+
+	while (1) {
+		node = pl_hp_protect(&hp, thr, 0, &top);
+		if (!node)
+			break;
+		if (node->magic != NODE_LIVE) {
+			fprintf(stderr, "Thread %ld found a freed node (magic=%#x)!\n", thr, node->magic);
+			exit(1);
+		}
+		next = node->next;
+		if (pl_cmpxchg(&top, node, next) == node)
+			break;
+	}
+	pl_hp_clear(&hp, thr, 0);
+	return node;
+}
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	struct node *node;
+	unsigned long n;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; n < arg_loops; n++) {
+		push(new_node());
+		node = pop(thr);
+		if (!node)
+			continue;
+		pops[thr]++;
+		if (arg_mode == 0)
+			free_node(&node->hp);
+		else
+			pl_hp_retire(&hp, thr, node, &node->hp, free_node);
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: hpstack [-h] [-m mode] [-t threads] [-l loops] [-p prefill]\n"
+	       "Modes :\n"
+	       "  0 : stack under a plock W\n"
+	       "  1 : lock-free stack with hazard pointers\n"
+	       "  2 : lock-free stack with hazard pointers and membarrier()\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, total, left, cpu;
+	struct node *node;
+	int asym;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			arg_threads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-p")) {
+			if (--argc < 0)
+				usage(1);
+			arg_prefill = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 2 || !arg_loops ||
+	    arg_threads < 1 || arg_threads > MAXTHREADS)
+		usage(1);
+
+	asym = pl_hp_init(&hp, hp_th, arg_threads, arg_mode == 2);
+	if (arg_mode == 2 && !asym)
+		fprintf(stderr, "membarrier() not supported, using regular barriers.\n");
+
+	for (i = 0; i < arg_prefill; i++)
+		push(new_node());
+
+	for (i = 0; i < arg_threads; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_threads; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	for (left = 0, node = top; node; node = node->next)
+		left++;
+
+	for (i = total = cpu = 0; i < arg_threads; i++) {
+		total += pops[i];
+		cpu += cpu_ns[i] / 1000;
+	}
+
+	if (total + left != arg_threads * arg_loops + arg_prefill) {
+		fprintf(stderr, "Bad count: %lu popped + %lu left, expected %lu!\n",
+		        total, left, arg_threads * arg_loops + arg_prefill);
+		exit(1);
+	}
+
+	printf("mode: %d threads: %d loops: %lu time(ms): %lu rate(lps): %Lu, cpu(ms): %lu (%lu%%)\n",
+	       arg_mode, arg_threads, total, ms, total * 1000ULL / ms,
+	       cpu / 1000, cpu / 10 / ms);
+	exit(0);
+}
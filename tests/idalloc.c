@@ -0,0 +1,228 @@
+/*
+ * Concurrent ID allocation benchmark -- 2026-10-17
+ *
+ * Threads allocate IDs from a shared bitmap, keep a few of them for a while
+ * and release the oldest one each time they allocate a new one. The bitmap is
+ * either manipulated with plain operations under a plock W lock, or with
+ * pl_bitmap_claim() and pl_bitmap_clear() starting from word 0, or starting
+ * from a word which depends on the thread to spread the contention. Each ID
+ * is associated with an owner which is checked while it is held to detect
+ * double allocations. At the end, all IDs must have been released, which is
+ * verified on a snapshot.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o idalloc idalloc.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pl-bitmap.h>
+
+#define MAXTHREADS 256
+#define MAXBITS    65536
+#define MAXHELD    64
+
+int arg_mode = 2;
+int arg_threads = 4;
+unsigned int arg_bits = 1024;
+unsigned int arg_held = 8;
+unsigned long arg_loops = 1000000;
+
+static unsigned long map[PL_BITMAP_LONGS(MAXBITS)];
+static unsigned long snap[PL_BITMAP_LONGS(MAXBITS)];
+static unsigned int owner[MAXBITS];
+static unsigned long lock;
+static volatile unsigned long step;
+static unsigned long failures[MAXTHREADS];
+static unsigned long cpu_ns[MAXTHREADS];
+static struct timeval start, stop;
+
+/* allocates an ID under the lock */
+static long locked_claim(unsigned int words)
+{
+	unsigned int w;
+	long bit = -1;
+
+	pl_take_w(&lock);
+	for (w = 0; w < words; w++) {
+		if (~map[w]) {
+			bit = __builtin_ctzl(~map[w]);
+			map[w] |= 1UL << bit;
+			bit += w * PL_BITMAP_LBITS;
+			break;
+		}
+	}
+	pl_drop_w(&lock);
+	return bit;
+}
+
+static void locked_release(unsigned int bit)
+{
+	pl_take_w(&lock);
+	map[bit / PL_BITMAP_LBITS] &= ~(1UL << (bit % PL_BITMAP_LBITS));
+	pl_drop_w(&lock);
+}
+
+static void release(unsigned int bit, long thr)
+{
+	if (pl_load(&owner[bit]) != thr + 1)
+		failures[thr]++;
+	pl_store(&owner[bit], 0);
+	if (arg_mode == 0)
+		locked_release(bit);
+	else
+		pl_bitmap_clear(map, bit);
+}
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	unsigned int words = PL_BITMAP_LONGS(arg_bits);
+	unsigned int hint = thr * words / arg_threads;
+	long held[MAXHELD];
+	unsigned long n;
+	unsigned int h;
+	long bit;
+	struct timespec ts;
+
+	for (h = 0; h < arg_held; h++)
+		held[h] = -1;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; n < arg_loops; n++) {
+		h = n % arg_held;
+		if (held[h] >= 0)
+			release(held[h], thr);
+
+		if (arg_mode == 0)
+			bit = locked_claim(words);
+		else
+			bit = pl_bitmap_claim(map, words, arg_mode == 2 ? hint : 0);
+
+		if (bit >= 0 && pl_xchg(&owner[bit], thr + 1) != 0)
+			failures[thr]++;
+		held[h] = bit;
+	}
+
+	for (h = 0; h < arg_held; h++)
+		if (held[h] >= 0)
+			release(held[h], thr);
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: idalloc [-h] [-m mode] [-t threads] [-b bits] [-k held] [-l loops]\n"
+	       "Modes :\n"
+	       "  0 : bitmap under a plock\n"
+	       "  1 : pl_bitmap_claim() from word 0\n"
+	       "  2 : pl_bitmap_claim() from a per-thread hint\n"
+	       "The number of bits must be a multiple of %d and at least threads*held.\n"
+	       "\n", (int)PL_BITMAP_LBITS);
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, total, cpu, fails, count;
+	unsigned int words;
+	long i, bit;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			arg_threads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-b")) {
+			if (--argc < 0)
+				usage(1);
+			arg_bits = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-k")) {
+			if (--argc < 0)
+				usage(1);
+			arg_held = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 2 || !arg_loops ||
+	    arg_threads < 1 || arg_threads > MAXTHREADS ||
+	    arg_held < 1 || arg_held > MAXHELD ||
+	    !arg_bits || arg_bits > MAXBITS || arg_bits % PL_BITMAP_LBITS ||
+	    arg_bits < arg_threads * arg_held)
+		usage(1);
+
+	words = PL_BITMAP_LONGS(arg_bits);
+
+	for (i = 0; i < arg_threads; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_threads; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	for (i = fails = cpu = 0; i < arg_threads; i++) {
+		fails += failures[i];
+		cpu += cpu_ns[i] / 1000;
+	}
+
+	/* all IDs must have been released */
+	pl_bitmap_snapshot(snap, map, words, 1);
+	count = 0;
+	pl_bitmap_foreach(snap, words, bit)
+		count++;
+
+	if (fails || count || pl_bitmap_count(map, words)) {
+		fprintf(stderr, "Bad allocation: %lu owner mismatches, %lu IDs left!\n", fails, count);
+		exit(1);
+	}
+
+	total = arg_threads * arg_loops;
+	printf("mode: %d threads: %d bits: %u held: %u allocs: %lu time(ms): %lu rate(aps): %Lu, cpu(ms): %lu (%lu%%)\n",
+	       arg_mode, arg_threads, arg_bits, arg_held, total, ms, total * 1000ULL / ms,
+	       cpu / 1000, cpu / 10 / ms);
+	exit(0);
+}
@@ -24,7 +24,7 @@
  *
  * To compile, libpthread is needed :
  *
- *   gcc -I.. -O2 -fomit-frame-pointer -s -o lrubench lrubench.c -lpthread
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o lrubench lrubench.c -lpthread -lm
  *
  * The default cache size is set to 100 entries per list head, which is 3200
  * entries for 32 heads. This can be adjusted using "-s". The default key space
@@ -35,6 +35,16 @@
  * supported with a single thread (to serve as a reference). Run with "-h" to
  * get some help.
  *
+ * Keys are uniformly distributed over the key space by default, which is not
+ * representative of real caches. A few other distributions may be selected
+ * using "-d" : a Zipf distribution of exponent "-z" (0.99 by default), a hot
+ * spot where "-T" percent of the traffic goes to "-H" percent of the keys, a
+ * hot window of the same size sliding over the key space every "-P" ms, and
+ * periodic flash crowds where for one quarter of each period, "-T" percent of
+ * the traffic goes to a random set of "-H" percent of the keys on top of a
+ * Zipf distribution. Zipf uses a precomputed alias table so that drawing a key
+ * only costs two random numbers and two memory reads.
+ *
  */
 
 #include <sys/time.h>
@@ -44,6 +54,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <math.h>
 #include <plock.h>
 
 #define MAXTHREADS	256
@@ -59,6 +70,11 @@ unsigned int arg_miss_cost = 100;
 unsigned int nbthreads = 2;
 int arg_nice = 0;
 int arg_mode = 0;
+unsigned int arg_dist = 0;
+double arg_zipf = 0.99;
+unsigned int arg_hot_size = 10;  /* percent of the key space */
+unsigned int arg_hot_rate = 90;  /* percent of the traffic */
+unsigned int arg_period = 100;   /* ms */
 
 /*
  * All we need to manage circular lists
@@ -230,6 +246,120 @@ static inline uint32_t rnd32_range(uint32_t range)
         return res >> 32;
 }
 
+/*
+ * Key distributions
+ */
+
+/* number of keys in the hot set, and milliseconds elapsed since the start,
+ * updated by the main thread for the time-varying distributions.
+ */
+static unsigned int hot_keys;
+static volatile unsigned int key_tick;
+
+/* alias table for the Zipf distribution (Vose's method) : column <i> is
+ * picked uniformly, then rank <i> is returned if a random number is below
+ * zipf_prob[i], otherwise zipf_alias[i] is returned.
+ */
+static uint32_t *zipf_prob;
+static uint32_t *zipf_alias;
+
+/* builds the alias table for a Zipf distribution of exponent <s> over <n>
+ * ranks. Returns < 0 on allocation failure.
+ */
+static int zipf_init(unsigned int n, double s)
+{
+	unsigned int *small, *large;
+	unsigned int nsmall = 0, nlarge = 0;
+	unsigned int i, l, g;
+	double *p, sum = 0.0;
+
+	p = calloc(n, sizeof(*p));
+	small = calloc(n, sizeof(*small));
+	large = calloc(n, sizeof(*large));
+	zipf_prob = calloc(n, sizeof(*zipf_prob));
+	zipf_alias = calloc(n, sizeof(*zipf_alias));
+	if (!p || !small || !large || !zipf_prob || !zipf_alias)
+		return -1;
+
+	for (i = 0; i < n; i++)
+		sum += p[i] = 1.0 / pow(i + 1, s);
+
+	/* scale the probabilities so that their average is 1 */
+	for (i = 0; i < n; i++) {
+		p[i] = p[i] * n / sum;
+		if (p[i] < 1.0)
+			small[nsmall++] = i;
+		else
+			large[nlarge++] = i;
+	}
+
+	while (nsmall && nlarge) {
+		l = small[--nsmall];
+		g = large[--nlarge];
+		zipf_prob[l] = p[l] * 4294967296.0;
+		zipf_alias[l] = g;
+		p[g] = (p[g] + p[l]) - 1.0;
+		if (p[g] < 1.0)
+			small[nsmall++] = g;
+		else
+			large[nlarge++] = g;
+	}
+
+	/* the remaining ones are only left due to rounding errors */
+	while (nlarge) {
+		g = large[--nlarge];
+		zipf_prob[g] = ~0U;
+		zipf_alias[g] = g;
+	}
+	while (nsmall) {
+		l = small[--nsmall];
+		zipf_prob[l] = ~0U;
+		zipf_alias[l] = l;
+	}
+
+	free(p); free(small); free(large);
+	return 0;
+}
+
+/* returns a Zipf-distributed rank between 0 and arg_key_space-1 */
+static inline unsigned int zipf_rank()
+{
+	unsigned int i = rnd32_range(arg_key_space);
+
+	return (rnd32() < zipf_prob[i]) ? i : zipf_alias[i];
+}
+
+/* returns the next key to look up according to the configured distribution */
+static inline unsigned int next_key()
+{
+	unsigned int phase;
+
+	switch (arg_dist) {
+	case 1: /* Zipf */
+		return zipf_rank();
+
+	case 2: /* fixed hot spot */
+		if (rnd32_range(100) < arg_hot_rate)
+			return rnd32_range(hot_keys);
+		break;
+
+	case 3: /* hot window sliding by a quarter of its size every period */
+		if (rnd32_range(100) < arg_hot_rate) {
+			phase = key_tick / arg_period;
+			return (phase * ((hot_keys + 3) / 4) + rnd32_range(hot_keys)) % arg_key_space;
+		}
+		break;
+
+	case 4: /* flash crowd during the first quarter of each period */
+		phase = key_tick / arg_period;
+		if (key_tick - phase * arg_period < (arg_period + 3) / 4 &&
+		    rnd32_range(100) < arg_hot_rate)
+			return (phase * 2654435761U + rnd32_range(hot_keys)) % arg_key_space;
+		return zipf_rank();
+	}
+	return rnd32_range(arg_key_space);
+}
+
 /* make the "expensive" work */
 static void produce_data(unsigned int k, char *str, int size)
 {
@@ -256,7 +386,7 @@ void loop_mode0(void)
 	char str[STRSZ];
 
 	while (step == 2) {
-		k = rnd32_range(arg_key_space);
+		k = next_key();
 
 		/* lookup */
 		if ((c = cache_lookup(k))) {
@@ -292,7 +422,7 @@ void loop_mode1(void)
 	char str[STRSZ];
 
 	while (step == 2) {
-		k = rnd32_range(arg_key_space);
+		k = next_key();
 
 		/* lookup */
 		pthread_spin_lock(&cache_lock.spinlock);
@@ -339,7 +469,7 @@ void loop_mode2(void)
 	char str[STRSZ];
 
 	while (step == 2) {
-		k = rnd32_range(arg_key_space);
+		k = next_key();
 
 		/* first check if the key is present */
 		pthread_rwlock_rdlock(&cache_lock.rwlock);
@@ -385,7 +515,7 @@ void loop_mode3(void)
 	char str[STRSZ];
 
 	while (step == 2) {
-		k = rnd32_range(arg_key_space);
+		k = next_key();
 
 		/* lookup */
 		pl_take_w(&cache_lock.plock);
@@ -430,7 +560,7 @@ void loop_mode4(void)
 	char str[STRSZ];
 
 	while (step == 2) {
-		k = rnd32_range(arg_key_space);
+		k = next_key();
 
 		/* lookup */
 		pl_take_s(&cache_lock.plock);
@@ -475,7 +605,7 @@ void loop_mode5(void)
 	char str[STRSZ];
 
 	while (step == 2) {
-		k = rnd32_range(arg_key_space);
+		k = next_key();
 
 		/* lookup */
 		pl_take_r(&cache_lock.plock);
@@ -520,7 +650,7 @@ void loop_mode6(void)
 	char str[STRSZ];
 
 	while (step == 2) {
-		k = rnd32_range(arg_key_space);
+		k = next_key();
 
 		/* lookup */
 		pl_take_r(&cache_lock.plock);
@@ -567,7 +697,7 @@ void loop_mode7(void)
 	char str[STRSZ];
 
 	while (step == 2) {
-		k = rnd32_range(arg_key_space);
+		k = next_key();
 
 		/* lookup */
 		pl_take_r(&cache_lock.plock);
@@ -622,7 +752,7 @@ void loop_mode8(void)
 	char str[STRSZ];
 
 	while (step == 2) {
-		k = rnd32_range(arg_key_space);
+		k = next_key();
 
 		/* lookup */
 		pl_take_r(&cache_lock.plock);
@@ -676,7 +806,7 @@ void loop_mode9(void)
 	char str[STRSZ];
 
 	while (step == 2) {
-		k = rnd32_range(arg_key_space);
+		k = next_key();
 
 		/* lookup */
 		pl_take_r(&cache_lock.plock);
@@ -721,7 +851,7 @@ void loop_mode10(void)
 	char str[STRSZ];
 
 	while (step == 2) {
-		k = rnd32_range(arg_key_space);
+		k = next_key();
 
 		/* lookup */
 		pl_lorw_wrlock(&cache_lock.plock);
@@ -767,7 +897,7 @@ void loop_mode11(void)
 	char str[STRSZ];
 
 	while (step == 2) {
-		k = rnd32_range(arg_key_space);
+		k = next_key();
 
 		/* lookup */
 		pl_lorw_rdlock(&cache_lock.plock);
@@ -853,6 +983,7 @@ void oneatwork(int thr)
 void usage(int ret)
 {
 	printf("usage: lrubench [-h] [-n nice] [-t threads] [-s size] [-k key_space] [-c miss_cost] [-m mode]\n"
+	       "                [-d dist] [-z zipf_exp] [-H hot_pct] [-T traffic_pct] [-P period_ms]\n"
 	       "Modes :\n"
 	       "  0 : no lock (only with -t 1)\n"
 #if defined(__SIZEOF_PTHREAD_RWLOCK_T)
@@ -868,6 +999,12 @@ void usage(int ret)
 	       "  9 : plock R lock for lookup, J for insertion\n"
 	       " 10 : lorw W lock for lookup & insertion\n"
 	       " 11 : lorw R lock for lookup, W for insertion\n"
+	       "Key distributions :\n"
+	       "  0 : uniform over the key space (default)\n"
+	       "  1 : Zipf of exponent -z (default 0.99)\n"
+	       "  2 : hot spot : -T %% of the traffic on -H %% of the keys (default 90/10)\n"
+	       "  3 : sliding hot spot : same, moving by 1/4 of its size every -P ms (default 100)\n"
+	       "  4 : flash crowds : Zipf + hot spot on random keys 1/4 of every -P ms\n"
 	       "\n");
 	exit(ret);
 }
@@ -877,6 +1014,7 @@ int main(int argc, char **argv)
 	int i, err;
 	unsigned long u;
 	unsigned long total, misses;
+	struct timeval now;
 
 	argc--; argv++;
 	while (argc > 0) {
@@ -910,6 +1048,31 @@ int main(int argc, char **argv)
 				usage(1);
 			arg_miss_cost = atol(*++argv);
 		}
+		else if (!strcmp(*argv, "-d")) {
+			if (--argc < 0)
+				usage(1);
+			arg_dist = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-z")) {
+			if (--argc < 0)
+				usage(1);
+			arg_zipf = atof(*++argv);
+		}
+		else if (!strcmp(*argv, "-H")) {
+			if (--argc < 0)
+				usage(1);
+			arg_hot_size = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-T")) {
+			if (--argc < 0)
+				usage(1);
+			arg_hot_rate = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-P")) {
+			if (--argc < 0)
+				usage(1);
+			arg_period = atol(*++argv);
+		}
 		else if (!strcmp(*argv, "-h"))
 			usage(0);
 		else
@@ -925,6 +1088,21 @@ int main(int argc, char **argv)
 		usage(1);
 	}
 
+	if (arg_dist > 4 || !arg_key_space || !arg_period ||
+	    !arg_hot_size || arg_hot_size > 100 || arg_hot_rate > 100) {
+		fprintf(stderr, "Invalid key distribution settings.\n");
+		usage(1);
+	}
+
+	hot_keys = (unsigned long long)arg_key_space * arg_hot_size / 100;
+	if (!hot_keys)
+		hot_keys = 1;
+
+	if ((arg_dist == 1 || arg_dist == 4) && zipf_init(arg_key_space, arg_zipf) < 0) {
+		perror("zipf_init");
+		exit(1);
+	}
+
 	nice(arg_nice);
 
 	actthreads = 0;	step = 0;
@@ -960,7 +1138,14 @@ int main(int argc, char **argv)
 	gettimeofday(&start, NULL);
 	pl_inc_noret(&step); /* fire ! */
 
-	sleep(2);
+	/* run for two seconds, maintaining the tick used by the time-varying
+	 * key distributions.
+	 */
+	do {
+		usleep(1000);
+		gettimeofday(&now, NULL);
+		key_tick = (now.tv_sec - start.tv_sec) * 1000 + ((int)now.tv_usec - (int)start.tv_usec) / 1000;
+	} while (key_tick < 2000);
 	pl_inc_noret(&step);
 	gettimeofday(&stop, NULL);
 
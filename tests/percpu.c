@@ -0,0 +1,231 @@
+/*
+ * Per-CPU operations tester -- 2026-10-17
+ *
+ * Threads either increment counters or take objects from a pool and return
+ * them. Counters are incremented either with an atomic add on a shared word,
+ * with pl_percpu_add() on per-CPU slots, or with a pl_percpu_cmpxchg() loop
+ * on per-CPU slots. The pool is either a single list protected by a plock, or
+ * the per-CPU lists of pl_percpu_pop()/pl_percpu_push(), where a thread finding
+ * its CPU's list empty takes one object from the shared reserve. The sum of
+ * the counters and the number of objects are checked at the end. Whether rseq
+ * is used or not is reported.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o percpu percpu.c -lpthread
+ */
+
+#define PL_USE_PERCPU
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <plock.h>
+
+#define MAXTHREADS 64
+#define MAXCPUS    1024
+#define MAXOBJS    4096
+
+struct slot {
+	unsigned long count;
+} __attribute__((aligned(64)));
+
+struct obj {
+	struct pl_percpu_node node; /* must be first */
+	unsigned long uses;
+};
+
+int arg_mode = 1;
+int arg_threads = 4;
+unsigned long arg_loops = 1000000;
+
+static unsigned long shared_count;
+static struct slot slots[MAXCPUS];
+static struct pl_percpu_list lists[MAXCPUS];
+static struct obj objs[MAXOBJS];
+static struct pl_percpu_node *reserve;
+static unsigned long reserve_lock;
+
+static volatile unsigned long step;
+static unsigned long cpu_ns[MAXTHREADS];
+static struct timeval start, stop;
+
+/* pops an object from the shared reserve, protected by a plock */
+static struct obj *reserve_pop()
+{
+	struct pl_percpu_node *node;
+
+	pl_take_w(&reserve_lock);
+	node = reserve;
+	if (node)
+		reserve = node->next;
+	pl_drop_w(&reserve_lock);
+	return (struct obj *)node;
+}
+
+static void reserve_push(struct obj *obj)
+{
+	pl_take_w(&reserve_lock);
+	obj->node.next = reserve;
+	reserve = &obj->node;
+	pl_drop_w(&reserve_lock);
+}
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	unsigned long n, old;
+	unsigned int cpu;
+	struct obj *obj;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; n < arg_loops; n++) {
+		switch (arg_mode) {
+		case 0:
+			pl_inc_noret(&shared_count);
+			break;
+		case 1:
+			pl_percpu_add(&slots[0].count, sizeof(*slots), 1);
+			break;
+		case 2:
+			do {
+				cpu = pl_percpu_cpu();
+				old = pl_load(&slots[cpu].count);
+			} while (!pl_percpu_cmpxchg(&slots[cpu].count, old, old + 1, cpu));
+			break;
+		case 3:
+			obj = reserve_pop();
+			obj->uses++;
+			reserve_push(obj);
+			break;
+		case 4:
+			obj = (struct obj *)pl_percpu_pop(lists);
+			if (!obj)
+				obj = reserve_pop();
+			obj->uses++;
+			pl_percpu_push(lists, &obj->node);
+			break;
+		}
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: percpu [-h] [-m mode] [-t threads] [-l loops]\n"
+	       "Modes :\n"
+	       "  0 : atomic increment of a shared counter\n"
+	       "  1 : pl_percpu_add() on per-CPU counters\n"
+	       "  2 : pl_percpu_cmpxchg() loop on per-CPU counters\n"
+	       "  3 : object pool in a single list protected by a plock\n"
+	       "  4 : object pool in per-CPU lists (pl_percpu_pop/push)\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, total, cpu, nobj;
+	struct pl_percpu_node *node;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			arg_threads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 4 || !arg_loops ||
+	    arg_threads < 1 || arg_threads > MAXTHREADS)
+		usage(1);
+
+	if (sysconf(_SC_NPROCESSORS_CONF) > MAXCPUS) {
+		fprintf(stderr, "Too many CPUs, at most %d supported.\n", MAXCPUS);
+		exit(1);
+	}
+
+	for (i = 0; i < MAXOBJS; i++)
+		reserve_push(&objs[i]);
+
+	for (i = 0; i < arg_threads; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_threads; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	total = shared_count;
+	for (i = 0; i < MAXCPUS; i++)
+		total += slots[i].count;
+
+	nobj = 0;
+	for (i = 0; i < MAXOBJS; i++)
+		total += objs[i].uses;
+
+	for (node = reserve; node; node = node->next)
+		nobj++;
+	for (i = 0; i < MAXCPUS; i++)
+		for (node = lists[i].head; node; node = node->next)
+			nobj++;
+
+	if (total != arg_threads * arg_loops || nobj != MAXOBJS) {
+		fprintf(stderr, "Bad total %lu, expected %lu, or objects %lu, expected %d!\n",
+			total, arg_threads * arg_loops, nobj, MAXOBJS);
+		exit(1);
+	}
+
+	for (i = cpu = 0; i < arg_threads; i++)
+		cpu += cpu_ns[i] / 1000;
+
+#if defined(PL_PERCPU_RSEQ)
+	printf("rseq: %s ", __pl_rseq_area() ? "yes" : "no");
+#else
+	printf("rseq: no ");
+#endif
+	printf("mode: %d threads: %d loops: %lu time(ms): %lu rate(lps): %Lu, cpu(ms): %lu (%lu%%)\n",
+	       arg_mode, arg_threads, total, ms, total * 1000ULL / ms,
+	       cpu / 1000, cpu / 10 / ms);
+	exit(0);
+}
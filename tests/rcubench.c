@@ -0,0 +1,267 @@
+/*
+ * RCU-style publication tester -- 2026-10-17
+ *
+ * Readers perform lookups into a configuration table which writers keep
+ * replacing as a whole by a new version. Readers either take the R lock around
+ * the lookup, in which case the writers swap the table under the W lock and
+ * free the old one immediately, or only load the table pointer and report a
+ * quiescent state every few lookups, in which case the writers wait for a
+ * grace period before freeing the old table. Freed tables are poisoned before
+ * being released, and the readers check each entry they visit. Each new table
+ * is derived from the current one by incrementing its generation, so that the
+ * final generation must match the number of updates if none was lost.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o rcubench rcubench.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pl-rcu.h>
+
+#define MAXTHREADS 64
+
+#define CFG_LIVE  0x4c495645U
+#define CFG_DEAD  0xdeaddeadU
+
+struct cfg {
+	unsigned int gen;
+	unsigned int magic;
+	unsigned int size;
+	unsigned long entries[0];
+};
+
+int arg_mode = 0;
+int arg_readers = 3;
+int arg_writers = 1;
+unsigned int arg_entries = 1024;
+unsigned long arg_loops = 1000000;
+unsigned int arg_qs = 16;
+unsigned int arg_delay = 100;
+
+static struct cfg *config;
+static unsigned long lock;
+static struct pl_rcu rcu;
+static struct pl_rcu_thread rcu_th[MAXTHREADS];
+static unsigned long lookups[MAXTHREADS];
+static unsigned long updates[MAXTHREADS];
+static unsigned int readers_left;
+static volatile unsigned long step;
+static struct timeval start, stop;
+
+static struct cfg *new_cfg(unsigned int gen)
+{
+	struct cfg *cfg = malloc(sizeof(*cfg) + arg_entries * sizeof(cfg->entries[0]));
+	unsigned int i;
+
+	if (!cfg) {
+		perror("malloc");
+		exit(1);
+	}
+	cfg->gen = gen;
+	cfg->magic = CFG_LIVE;
+	cfg->size = arg_entries;
+	for (i = 0; i < arg_entries; i++)
+		cfg->entries[i] = gen ^ i;
+	return cfg;
+}
+
+static void free_cfg(struct cfg *cfg)
+{
+	cfg->magic = CFG_DEAD;
+	memset(cfg->entries, 0xff, cfg->size * sizeof(cfg->entries[0]));
+	free(cfg);
+}
+
+static inline unsigned int rnd32(unsigned int *state)
+{
+	unsigned int x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+void *reader(void *arg)
+{
+	long thr = (long)arg;
+	unsigned int rnd = thr * 2654435761U + 1;
+	struct cfg *cfg;
+	unsigned long n;
+	unsigned int i;
+
+	while (step == 0)
+		usleep(10000);
+
+	if (arg_mode == 1)
+		pl_rcu_online(&rcu, thr);
+
+	for (n = 0; n < arg_loops; n++) {
+		if (arg_mode == 0)
+			pl_take_r(&lock);
+
+		cfg = pl_rcu_deref(&config);
+		i = rnd32(&rnd) % arg_entries;
+		if (cfg->magic != CFG_LIVE || cfg->entries[i] != (cfg->gen ^ i)) {
+			fprintf(stderr, "Thread %ld found a freed table (magic=%#x)!\n", thr, cfg->magic);
+			exit(1);
+		}
+
+		if (arg_mode == 0)
+			pl_drop_r(&lock);
+		else if (!(n % arg_qs))
+			pl_rcu_quiescent(&rcu, thr);
+	}
+
+	if (arg_mode == 1)
+		pl_rcu_offline(&rcu, thr);
+
+	lookups[thr] = n;
+	pl_dec_noret(&readers_left);
+	return NULL;
+}
+
+void *writer(void *arg)
+{
+	long thr = (long)arg;
+	struct cfg *cfg, *old;
+	unsigned long n;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; pl_load(&readers_left); n++) {
+		if (arg_delay)
+			usleep(arg_delay);
+
+		if (arg_mode == 0) {
+			pl_take_w(&lock);
+			old = config;
+			config = new_cfg(old->gen + 1);
+			pl_drop_w(&lock);
+		}
+		else {
+			pl_rcu_write_lock(&rcu);
+			old = pl_rcu_deref(&config);
+			cfg = new_cfg(old->gen + 1);
+			pl_rcu_publish(&rcu, &config, cfg);
+			pl_rcu_write_unlock(&rcu);
+			pl_rcu_synchronize(&rcu);
+		}
+		free_cfg(old);
+	}
+
+	updates[thr] = n;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: rcubench [-h] [-m mode] [-r readers] [-w writers] [-e entries] [-l loops] [-q qs_interval] [-d delay_us]\n"
+	       "Modes :\n"
+	       "  0 : readers take the R lock, writers free immediately\n"
+	       "  1 : readers only load the pointer, writers wait for a grace period\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, reads, writes;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-r")) {
+			if (--argc < 0)
+				usage(1);
+			arg_readers = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-w")) {
+			if (--argc < 0)
+				usage(1);
+			arg_writers = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-e")) {
+			if (--argc < 0)
+				usage(1);
+			arg_entries = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-q")) {
+			if (--argc < 0)
+				usage(1);
+			arg_qs = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-d")) {
+			if (--argc < 0)
+				usage(1);
+			arg_delay = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 1 || !arg_loops || !arg_qs || !arg_entries ||
+	    arg_readers < 1 || arg_writers < 0 || arg_readers + arg_writers > MAXTHREADS)
+		usage(1);
+
+	config = new_cfg(0);
+	pl_rcu_init(&rcu, rcu_th, arg_readers);
+	readers_left = arg_readers;
+
+	for (i = 0; i < arg_readers + arg_writers; i++) {
+		if (pthread_create(&thr[i], NULL, (i < arg_readers) ? reader : writer, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_readers + arg_writers; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	for (i = reads = writes = 0; i < arg_readers + arg_writers; i++) {
+		reads += lookups[i];
+		writes += updates[i];
+	}
+
+	if (config->gen != writes) {
+		fprintf(stderr, "Lost updates: generation %u after %lu updates!\n", config->gen, writes);
+		exit(1);
+	}
+
+	printf("mode: %d readers: %d writers: %d entries: %u lookups: %lu updates: %lu time(ms): %lu rate(lps): %Lu\n",
+	       arg_mode, arg_readers, arg_writers, arg_entries, reads, writes, ms, reads * 1000ULL / ms);
+	exit(0);
+}
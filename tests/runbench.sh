@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# Runs a test program several times and appends its results to a file in the
+# format expected by benchcmp, one "<config> <value>" line per run. The value
+# is taken from the last "rate(lps):" field of the output, or from the field
+# named in $FIELD (e.g. FIELD="bounce(ns):" for latency).
+#
+# usage: runbench.sh <output> <runs> <config> <command> [args...]
+# example:
+#   for t in 1 2 4 8; do
+#     ./runbench.sh before.txt 10 lrubench:t$t:m5 ./lrubench -t $t -m 5
+#   done
+#   (rebuild with the new plock.h, then same with after.txt)
+#   ./benchcmp before.txt after.txt
+
+FIELD=${FIELD:-rate(lps):}
+
+if [ $# -lt 4 ]; then
+        echo "usage: $0 <output> <runs> <config> <command> [args...]" >&2
+        exit 1
+fi
+
+OUT=$1; RUNS=$2; CFG=$3
+shift 3
+
+for ((i = 0; i < RUNS; i++)); do
+        "$@" | awk -v f="$FIELD" -v c="$CFG" '{for (i = 1; i < NF; i++) if ($i == f) v = $(i+1)} END{if (v != "") print c, v+0; else exit 1}' >> "$OUT" || {
+                echo "$0: no '$FIELD' field in output of $*" >&2
+                exit 1
+        }
+done
@@ -0,0 +1,718 @@
+/*
+ * Scheduler benchmark for locking mechanisms -- 2026-10-17
+ *
+ * This benchmark models the event loop of a proxy such as HAProxy in order to
+ * measure the effect of a change to plock.h on a representative end-to-end
+ * workload instead of a single structure. Each thread runs a loop which :
+ *   - wakes up the tasks whose timer expired in the shared wait queue, and
+ *     moves them to the run queue of the thread they belong to ;
+ *   - picks a batch of tasks from the shared run queue ;
+ *   - picks a batch of tasks from its own run queue, which other threads may
+ *     feed by waking tasks up ;
+ *   - runs these tasks. Running a task consists in looking up a random entry
+ *     in a shared connection table and updating it for a fraction of the
+ *     lookups, burning a few cycles, then either queuing the task in the wait
+ *     queue with a timer, waking it up on another thread, queuing it in the
+ *     shared run queue or requeuing it locally.
+ *
+ * The wait queue is a binary heap keyed by expiration date, the run queues
+ * and the connection table buckets are lists. All of these are accessed using
+ * the same "lookup, then upgrade to update" pattern, and each structure's
+ * locking strategy may be set independently among :
+ *   0 : plock W for lookups and updates
+ *   1 : plock S for lookups, S->W for updates
+ *   2 : plock R for lookups, W for updates (lookup performed again)
+ *   3 : plock R for lookups, R->W for updates (fallback to 2 on failure)
+ *   4 : lorw R for lookups, W for updates (lookup performed again)
+ *
+ * The number of tasks run per second is reported, as well as the number of
+ * timers, cross-thread wakeups and connection updates. The number of tasks is
+ * verified at the end.
+ *
+ * You can do whatever you want with this program, I'm not responsible for any
+ * misuse.
+ *
+ * To compile, libpthread is needed :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o schedbench schedbench.c -lpthread
+ */
+
+#include <sys/time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <plock.h>
+
+#define MAXTHREADS	256
+#define NBBUCKETS	1024
+#define BATCH		16
+
+/* lock modes */
+#define LM_W		0
+#define LM_S		1
+#define LM_RW		2
+#define LM_RTOW		3
+#define LM_LORW		4
+#define LM_MAX		5
+
+/* runtime arguments */
+unsigned int nbthreads = 2;
+unsigned int arg_tasks = 1000;   /* tasks per thread */
+unsigned int arg_conns = 10000;  /* entries in the connection table */
+unsigned int arg_update = 10;    /* percent of lookups followed by an update */
+unsigned int arg_timer = 5;      /* percent of tasks going to the wait queue */
+unsigned int arg_remote = 20;    /* percent of tasks woken on another thread */
+unsigned int arg_shared = 10;    /* percent of tasks going to the shared rq */
+unsigned int arg_cost = 50;      /* work per task */
+int arg_mode_rq = LM_W;
+int arg_mode_grq = LM_W;
+int arg_mode_wq = LM_W;
+int arg_mode_ct = LM_RW;
+int arg_nice = 0;
+
+/*
+ * All we need to manage circular lists
+ */
+struct list {
+	struct list *n;
+	struct list *p;
+};
+
+#define LIST_INIT(l)          ((l)->n = (l)->p = (l))
+#define LIST_ADD(lh, el)      ({ (el)->n = (lh)->n; (el)->n->p = (lh)->n = (el); (el)->p = (lh); (el); })
+#define LIST_ADDQ(lh, el)     ({ (el)->p = (lh)->p; (el)->p->n = (lh)->p = (el); (el)->n = (lh); (el); })
+#define LIST_DEL(el)          ({ typeof(el) __ret = (el); (el)->n->p = (el)->p; (el)->p->n = (el)->n; (__ret); })
+#define LIST_ELEM(lh, pt, el) ((pt)(((void *)(lh)) - ((void *)&((pt)NULL)->el)))
+#define LIST_ISEMPTY(lh)      ((lh)->n == (lh))
+#define LIST_FOR_EACH_ENTRY(item, list_head, member)                     \
+        for (item = LIST_ELEM((list_head)->n, typeof(item), member);     \
+             &item->member != (list_head);                               \
+             item = LIST_ELEM(item->member.n, typeof(item), member))
+
+/*
+ * Locks with a selectable strategy
+ */
+
+struct slock {
+	unsigned long lock;
+	int mode;
+};
+
+/* locks <l> for a lookup */
+static inline void lk_look(struct slock *l)
+{
+	switch (l->mode) {
+	case LM_W:    pl_take_w(&l->lock); break;
+	case LM_S:    pl_take_s(&l->lock); break;
+	case LM_RW:
+	case LM_RTOW: pl_take_r(&l->lock); break;
+	case LM_LORW: pl_lorw_rdlock(&l->lock); break;
+	}
+}
+
+/* releases a lookup lock on <l> */
+static inline void lk_unlook(struct slock *l)
+{
+	switch (l->mode) {
+	case LM_W:    pl_drop_w(&l->lock); break;
+	case LM_S:    pl_drop_s(&l->lock); break;
+	case LM_RW:
+	case LM_RTOW: pl_drop_r(&l->lock); break;
+	case LM_LORW: pl_lorw_rdunlock(&l->lock); break;
+	}
+}
+
+/* upgrades a lookup lock on <l> to an update lock. Returns non-zero if the
+ * lock was held all the time, or zero if it had to be released, in which case
+ * the lookup has to be performed again.
+ */
+static inline int lk_upgrade(struct slock *l)
+{
+	switch (l->mode) {
+	case LM_S:
+		pl_stow(&l->lock);
+		return 1;
+	case LM_RTOW:
+		if (pl_try_rtow(&l->lock))
+			return 1;
+		/* fall through */
+	case LM_RW:
+		pl_drop_r(&l->lock);
+		pl_take_w(&l->lock);
+		return 0;
+	case LM_LORW:
+		pl_lorw_rdunlock(&l->lock);
+		pl_lorw_wrlock(&l->lock);
+		return 0;
+	}
+	return 1;
+}
+
+/* locks <l> for an update */
+static inline void lk_update(struct slock *l)
+{
+	if (l->mode == LM_LORW)
+		pl_lorw_wrlock(&l->lock);
+	else
+		pl_take_w(&l->lock);
+}
+
+/* releases an update lock on <l>, possibly obtained after an upgrade */
+static inline void lk_unupdate(struct slock *l)
+{
+	if (l->mode == LM_LORW)
+		pl_lorw_wrunlock(&l->lock);
+	else
+		pl_drop_w(&l->lock);
+}
+
+/*
+ * Tasks and the structures holding them
+ */
+
+struct task {
+	struct list list;      /* attach point in a run queue */
+	unsigned int expire;   /* expiration date in the wait queue, in ms */
+	unsigned int tid;      /* thread the task runs on */
+};
+
+/* a run queue */
+struct rq {
+	struct slock lk;
+	struct list head;
+	unsigned int count;
+	char pad[0] __attribute__((aligned(64)));
+};
+
+/* the wait queue : a binary heap of tasks ordered by expiration date */
+struct wq {
+	struct slock lk;
+	struct task **heap;
+	unsigned int size;
+	char pad[0] __attribute__((aligned(64)));
+};
+
+/* a connection entry */
+struct conn {
+	struct list list;
+	unsigned int key;
+	unsigned long hits;
+};
+
+/* the connection table */
+struct ctable {
+	struct slock lk;
+	struct list head[NBBUCKETS];
+	char pad[0] __attribute__((aligned(64)));
+};
+
+struct rq rqs[MAXTHREADS] __attribute__((aligned(64)));
+struct rq grq __attribute__((aligned(64)));
+struct wq wq __attribute__((aligned(64)));
+struct ctable ct __attribute__((aligned(64)));
+
+/*
+ * The application stuff
+ */
+
+pthread_t thr[MAXTHREADS];
+static volatile unsigned long actthreads;
+static volatile unsigned long step;
+static volatile unsigned int now_ms;
+static struct timeval start, stop;
+static unsigned long final_work[MAXTHREADS];
+static unsigned long final_timers[MAXTHREADS];
+static unsigned long final_remote[MAXTHREADS];
+static unsigned long final_updates[MAXTHREADS];
+
+/* per-thread states */
+__thread uint32_t rnd32_state = 2463534242U;
+__thread unsigned long thread_work;
+__thread unsigned long thread_timers;
+__thread unsigned long thread_remote;
+__thread unsigned long thread_updates;
+__thread volatile unsigned long sink;
+
+/* Xorshift RNGs from http://www.jstatsoft.org/v08/i14/paper */
+static inline uint32_t rnd32()
+{
+        rnd32_state ^= rnd32_state << 13;
+        rnd32_state ^= rnd32_state >> 17;
+        rnd32_state ^= rnd32_state << 5;
+        return rnd32_state;
+}
+
+static inline uint32_t rnd32_range(uint32_t range)
+{
+        uint64_t res = rnd32();
+
+        res *= range;
+        return res >> 32;
+}
+
+/* returns non-zero if date <a> is before date <b>, supporting wrapping */
+static inline int tick_is_lt(unsigned int a, unsigned int b)
+{
+	return (int)(a - b) < 0;
+}
+
+/* appends task <t> to run queue <rq>, which must be locked for updates */
+static inline void rq_append(struct rq *rq, struct task *t)
+{
+	LIST_ADDQ(&rq->head, &t->list);
+	rq->count++;
+}
+
+/* wakes task <t> up on thread <tid>'s run queue */
+static inline void task_wakeup(struct task *t, unsigned int tid)
+{
+	struct rq *rq = &rqs[tid];
+
+	t->tid = tid;
+	lk_update(&rq->lk);
+	rq_append(rq, t);
+	lk_unupdate(&rq->lk);
+}
+
+/* moves up to <max> tasks from run queue <rq> to list <to>. Returns the
+ * number of tasks moved.
+ */
+static inline unsigned int rq_pick(struct rq *rq, struct list *to, unsigned int max)
+{
+	struct list *l;
+	unsigned int n = 0;
+
+	/* check without the lock first, as an idle thread would do */
+	if (!pl_load(&rq->count))
+		return 0;
+
+	lk_look(&rq->lk);
+	if (LIST_ISEMPTY(&rq->head)) {
+		lk_unlook(&rq->lk);
+		return 0;
+	}
+
+	/* the queue may have been emptied while the lock was released */
+	if (!lk_upgrade(&rq->lk) && LIST_ISEMPTY(&rq->head))
+		goto out;
+
+	while (n < max && !LIST_ISEMPTY(&rq->head)) {
+		l = rq->head.n;
+		LIST_DEL(l);
+		LIST_ADDQ(to, l);
+		rq->count--;
+		n++;
+	}
+ out:
+	lk_unupdate(&rq->lk);
+	return n;
+}
+
+/* inserts task <t> into the wait queue, which must be locked for updates */
+static inline void wq_insert(struct task *t)
+{
+	unsigned int i = wq.size++, p;
+
+	while (i) {
+		p = (i - 1) / 2;
+		if (!tick_is_lt(t->expire, wq.heap[p]->expire))
+			break;
+		wq.heap[i] = wq.heap[p];
+		i = p;
+	}
+	wq.heap[i] = t;
+}
+
+/* removes and returns the first task of the wait queue, which must be locked
+ * for updates and not empty.
+ */
+static inline struct task *wq_pop(void)
+{
+	struct task *ret = wq.heap[0];
+	struct task *last = wq.heap[--wq.size];
+	unsigned int i = 0, c;
+
+	while ((c = 2 * i + 1) < wq.size) {
+		if (c + 1 < wq.size && tick_is_lt(wq.heap[c + 1]->expire, wq.heap[c]->expire))
+			c++;
+		if (!tick_is_lt(wq.heap[c]->expire, last->expire))
+			break;
+		wq.heap[i] = wq.heap[c];
+		i = c;
+	}
+	wq.heap[i] = last;
+	return ret;
+}
+
+/* queues task <t> in the wait queue to expire <delay> ms from now */
+static inline void task_queue(struct task *t, unsigned int delay)
+{
+	t->expire = now_ms + delay;
+	lk_update(&wq.lk);
+	wq_insert(t);
+	lk_unupdate(&wq.lk);
+}
+
+/* wakes up to BATCH tasks whose timer expired on their respective thread */
+static inline void wake_expired_tasks(void)
+{
+	struct task *expired[BATCH];
+	unsigned int now = now_ms;
+	unsigned int n = 0, i;
+
+	lk_look(&wq.lk);
+	if (!wq.size || tick_is_lt(now, wq.heap[0]->expire)) {
+		lk_unlook(&wq.lk);
+		return;
+	}
+
+	if (!lk_upgrade(&wq.lk) && (!wq.size || tick_is_lt(now, wq.heap[0]->expire)))
+		goto out;
+
+	while (n < BATCH && wq.size && !tick_is_lt(now, wq.heap[0]->expire))
+		expired[n++] = wq_pop();
+ out:
+	lk_unupdate(&wq.lk);
+
+	for (i = 0; i < n; i++)
+		task_wakeup(expired[i], expired[i]->tid);
+	thread_timers += n;
+}
+
+/* finds key <k> in the connection table, which must be locked */
+static inline struct conn *ct_lookup(unsigned int k)
+{
+	struct conn *c;
+
+	LIST_FOR_EACH_ENTRY(c, &ct.head[k % NBBUCKETS], list)
+		if (c->key == k)
+			return c;
+	return NULL;
+}
+
+/* looks up connection <k> and updates it if <update> is set, in which case it
+ * is also moved to the head of its bucket.
+ */
+static inline void ct_access(unsigned int k, int update)
+{
+	struct conn *c;
+
+	lk_look(&ct.lk);
+	c = ct_lookup(k);
+	if (!update) {
+		sink = c->hits;
+		lk_unlook(&ct.lk);
+		return;
+	}
+
+	if (!lk_upgrade(&ct.lk))
+		c = ct_lookup(k);
+	c->hits++;
+	LIST_DEL(&c->list);
+	LIST_ADD(&ct.head[k % NBBUCKETS], &c->list);
+	lk_unupdate(&ct.lk);
+	thread_updates++;
+}
+
+/* runs task <t> on thread <tid> and decides where it goes next */
+static inline void task_run(struct task *t, unsigned int tid)
+{
+	volatile unsigned int i;
+	unsigned int r;
+
+	ct_access(rnd32_range(arg_conns), rnd32_range(100) < arg_update);
+
+	for (i = 0; i < arg_cost; i++);
+
+	r = rnd32_range(100);
+	if (r < arg_timer)
+		task_queue(t, 1 + rnd32_range(10));
+	else if ((r -= arg_timer) < arg_remote) {
+		task_wakeup(t, rnd32_range(nbthreads));
+		thread_remote++;
+	}
+	else if ((r -= arg_remote) < arg_shared) {
+		t->tid = tid;
+		lk_update(&grq.lk);
+		rq_append(&grq, t);
+		lk_unupdate(&grq.lk);
+	}
+	else
+		task_wakeup(t, tid);
+	thread_work++;
+}
+
+void oneatwork(void *arg)
+{
+	int tid = (long)arg;
+	struct list batch;
+	struct list *l;
+
+	LIST_INIT(&batch);
+	rnd32_state += tid;
+
+	/* step 0: creating all threads */
+	while (step == 0) {
+		/* don't disturb pthread_create() */
+		usleep(10000);
+	}
+
+	/* step 1 : waiting for signal to start */
+	pl_inc_noret(&actthreads);
+	while (step == 1);
+
+	/* step 2 : running */
+	while (step == 2) {
+		wake_expired_tasks();
+		rq_pick(&grq, &batch, BATCH);
+		rq_pick(&rqs[tid], &batch, BATCH);
+
+		if (LIST_ISEMPTY(&batch)) {
+			pl_cpu_relax();
+			continue;
+		}
+
+		while (!LIST_ISEMPTY(&batch)) {
+			l = batch.n;
+			LIST_DEL(l);
+			task_run(LIST_ELEM(l, struct task *, list), tid);
+		}
+	}
+
+	/* only time the first finishing thread */
+	if (pl_xadd(&step, 1) == 2) {
+		gettimeofday(&stop, NULL);
+	}
+
+	final_work[tid] = thread_work;
+	final_timers[tid] = thread_timers;
+	final_remote[tid] = thread_remote;
+	final_updates[tid] = thread_updates;
+	pl_dec_noret(&actthreads);
+	pthread_exit(0);
+}
+
+void usage(int ret)
+{
+	printf("usage: schedbench [-h] [-n nice] [-t threads] [-T tasks] [-C conns] [-u update_pct]\n"
+	       "                  [-p timer_pct] [-x remote_pct] [-g shared_pct] [-c cost]\n"
+	       "                  [-a mode] [-r rq_mode] [-s grq_mode] [-w wq_mode] [-k ct_mode]\n"
+	       "Options :\n"
+	       "  -T : number of tasks per thread (default 1000)\n"
+	       "  -C : number of entries in the connection table (default 10000)\n"
+	       "  -u : percent of connection lookups followed by an update (default 10)\n"
+	       "  -p : percent of tasks queued with a timer after running (default 5)\n"
+	       "  -x : percent of tasks woken up on a random thread (default 20)\n"
+	       "  -g : percent of tasks queued into the shared run queue (default 10)\n"
+	       "  -c : work per task in loops (default 50)\n"
+	       "  -a : lock mode for all structures\n"
+	       "  -r, -s, -w, -k : lock mode for the per-thread run queues (default 0), the shared\n"
+	       "       run queue (default 0), the wait queue (default 0), the connection table (default 2)\n"
+	       "Lock modes :\n"
+	       "  0 : plock W for lookups and updates\n"
+	       "  1 : plock S for lookups, S->W for updates\n"
+	       "  2 : plock R for lookups, W for updates\n"
+	       "  3 : plock R for lookups, R->W for updates\n"
+	       "  4 : lorw R for lookups, W for updates\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	int i, err;
+	unsigned long u, nbtasks, found;
+	unsigned long total, timers, remote, updates;
+	struct timeval now;
+	struct task *tasks;
+	struct conn *conns;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			nbthreads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-n")) {
+			if (--argc < 0)
+				usage(1);
+			arg_nice = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-T")) {
+			if (--argc < 0)
+				usage(1);
+			arg_tasks = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-C")) {
+			if (--argc < 0)
+				usage(1);
+			arg_conns = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-u")) {
+			if (--argc < 0)
+				usage(1);
+			arg_update = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-p")) {
+			if (--argc < 0)
+				usage(1);
+			arg_timer = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-x")) {
+			if (--argc < 0)
+				usage(1);
+			arg_remote = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-g")) {
+			if (--argc < 0)
+				usage(1);
+			arg_shared = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-c")) {
+			if (--argc < 0)
+				usage(1);
+			arg_cost = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-a")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode_rq = arg_mode_grq = arg_mode_wq = arg_mode_ct = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-r")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode_rq = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-s")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode_grq = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-w")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode_wq = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-k")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode_ct = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (nbthreads >= MAXTHREADS)
+		nbthreads = MAXTHREADS;
+
+	if (!nbthreads || !arg_tasks || !arg_conns ||
+	    (unsigned)arg_mode_rq >= LM_MAX || (unsigned)arg_mode_grq >= LM_MAX ||
+	    (unsigned)arg_mode_wq >= LM_MAX || (unsigned)arg_mode_ct >= LM_MAX ||
+	    arg_timer + arg_remote + arg_shared > 100)
+		usage(1);
+
+	nice(arg_nice);
+
+	actthreads = 0;	step = 0;
+
+	setbuf(stdout, NULL);
+
+	/* prepare the structures */
+	nbtasks = (unsigned long)arg_tasks * nbthreads;
+	tasks = calloc(nbtasks, sizeof(*tasks));
+	conns = calloc(arg_conns, sizeof(*conns));
+	wq.heap = calloc(nbtasks, sizeof(*wq.heap));
+	if (!tasks || !conns || !wq.heap) {
+		perror("calloc");
+		exit(1);
+	}
+
+	for (u = 0; u < nbthreads; u++) {
+		rqs[u].lk.mode = arg_mode_rq;
+		LIST_INIT(&rqs[u].head);
+	}
+	grq.lk.mode = arg_mode_grq;
+	LIST_INIT(&grq.head);
+	wq.lk.mode = arg_mode_wq;
+	ct.lk.mode = arg_mode_ct;
+
+	for (u = 0; u < NBBUCKETS; u++)
+		LIST_INIT(&ct.head[u]);
+
+	for (u = 0; u < arg_conns; u++) {
+		conns[u].key = u;
+		LIST_ADDQ(&ct.head[u % NBBUCKETS], &conns[u].list);
+	}
+
+	for (u = 0; u < nbtasks; u++) {
+		tasks[u].tid = u % nbthreads;
+		rq_append(&rqs[tasks[u].tid], &tasks[u]);
+	}
+
+	for (u = 0; u < nbthreads; u++) {
+		if ((err = pthread_create(&thr[u], NULL, (void *)&oneatwork, (void *)u)) != 0) {
+			perror("");
+			exit(1);
+		}
+		pthread_detach(thr[u]);
+	}
+
+	pl_inc_noret(&step);  /* let the threads warm up and get ready to start */
+
+	while (actthreads != nbthreads);
+
+	/* let CPUs burn at 100% to stabilize cpufreq */
+	usleep(200000);
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step); /* fire ! */
+
+	/* run for two seconds, maintaining the clock used by the timers */
+	do {
+		usleep(1000);
+		gettimeofday(&now, NULL);
+		now_ms = (now.tv_sec - start.tv_sec) * 1000 + ((int)now.tv_usec - (int)start.tv_usec) / 1000;
+	} while (now_ms < 2000);
+	pl_inc_noret(&step);
+	gettimeofday(&stop, NULL);
+
+	while (actthreads)
+		usleep(100000);
+
+	/* All the work has ended, all tasks must be queued somewhere */
+	found = grq.count + wq.size;
+	for (u = 0; u < nbthreads; u++)
+		found += rqs[u].count;
+
+	i = (stop.tv_usec - start.tv_usec);
+	while (i < 0) {
+		i += 1000000;
+		start.tv_sec++;
+	}
+	u = i / 1000U + (int)(stop.tv_sec - start.tv_sec) * 1000U;
+
+	total = timers = remote = updates = 0;
+	for (i = 0; i < (int)nbthreads; i++) {
+		total += final_work[i];
+		timers += final_timers[i];
+		remote += final_remote[i];
+		updates += final_updates[i];
+		printf("thread: %2d loops: %11lu time(ms): %lu rate(lps): %11Lu, timers=%lu remote=%lu updates=%lu\n",
+		       i, final_work[i], u, final_work[i] * 1000ULL / u, final_timers[i], final_remote[i], final_updates[i]);
+	}
+	printf("Global:    loops: %11lu time(ms): %lu rate(lps): %11Lu, timers=%lu remote=%lu updates=%lu tasks=%lu/%lu\n",
+	       total, u, total * 1000ULL / u, timers, remote, updates, found, nbtasks);
+
+	if (found != nbtasks) {
+		fprintf(stderr, "Lost tasks : found %lu out of %lu!\n", found, nbtasks);
+		exit(1);
+	}
+	exit(0);
+}
@@ -0,0 +1,191 @@
+/*
+ * Semaphore tester -- 2026-10-17
+ *
+ * Threads repeatedly take <k> permits from a semaphore holding <n> of them,
+ * work for some time, and release them. The semaphore is either a POSIX
+ * sem_t, on which sem_wait() and sem_post() are called <k> times, or a
+ * pl_sem. The number of permits in use is tracked to verify that it never
+ * exceeds the semaphore's size.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o semlock semlock.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pl-sem.h>
+
+#define MAXTHREADS 64
+
+int arg_mode = 0;
+int arg_threads = 4;
+int arg_permits = 2;
+int arg_batch = 1;
+unsigned long arg_loops = 100000;
+unsigned int arg_work = 100;
+unsigned int arg_delay = 0;
+
+static sem_t sem;
+static struct pl_sem plsem;
+static int inuse;
+static volatile unsigned long step;
+static unsigned long cpu_ns[MAXTHREADS];
+static struct timeval start, stop;
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	unsigned long n;
+	unsigned int w;
+	int k;
+	struct timespec ts;
+
+	while (step == 0)
+		usleep(10000);
+
+	for (n = 0; n < arg_loops; n++) {
+		if (arg_mode == 0) {
+			for (k = 0; k < arg_batch; k++)
+				while (sem_wait(&sem) != 0)
+					;
+		}
+		else
+			pl_sem_take_k(&plsem, arg_batch);
+
+		if (pl_ldadd(&inuse, arg_batch) + arg_batch > arg_permits) {
+			fprintf(stderr, "More than %d permits in use!\n", arg_permits);
+			exit(1);
+		}
+
+		for (w = 0; w < arg_work; w++)
+			pl_cpu_relax();
+		if (arg_delay)
+			usleep(arg_delay);
+
+		pl_sub_noret(&inuse, arg_batch);
+
+		if (arg_mode == 0) {
+			for (k = 0; k < arg_batch; k++)
+				sem_post(&sem);
+		}
+		else
+			pl_sem_drop_k(&plsem, arg_batch);
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: semlock [-h] [-m mode] [-t threads] [-n permits] [-k batch] [-l loops] [-w work] [-d delay_us]\n"
+	       "Modes :\n"
+	       "  0 : sem_wait() / sem_post() <batch> times\n"
+	       "  1 : pl_sem_take_k() / pl_sem_drop_k()\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, total, cpu;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			arg_threads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-n")) {
+			if (--argc < 0)
+				usage(1);
+			arg_permits = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-k")) {
+			if (--argc < 0)
+				usage(1);
+			arg_batch = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-w")) {
+			if (--argc < 0)
+				usage(1);
+			arg_work = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-d")) {
+			if (--argc < 0)
+				usage(1);
+			arg_delay = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	/* sem_t with batches may deadlock when threads hold partial batches */
+	if (arg_mode < 0 || arg_mode > 1 || !arg_loops ||
+	    arg_threads < 1 || arg_threads > MAXTHREADS ||
+	    arg_batch < 1 || arg_permits < arg_batch ||
+	    (arg_mode == 0 && arg_batch > 1 && arg_permits < arg_threads * arg_batch))
+		usage(1);
+
+	sem_init(&sem, 0, arg_permits);
+	pl_sem_init(&plsem, arg_permits);
+
+	for (i = 0; i < arg_threads; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_threads; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	if (arg_mode == 1 && pl_sem_avail(&plsem) != arg_permits) {
+		fprintf(stderr, "Semaphore left with %d permits instead of %d!\n", pl_sem_avail(&plsem), arg_permits);
+		exit(1);
+	}
+
+	total = arg_threads * arg_loops;
+	for (i = cpu = 0; i < arg_threads; i++)
+		cpu += cpu_ns[i] / 1000;
+
+	printf("mode: %d threads: %d permits: %d batch: %d loops: %lu time(ms): %lu rate(lps): %Lu, cpu(ms): %lu (%lu%%)\n",
+	       arg_mode, arg_threads, arg_permits, arg_batch, total, ms, total * 1000ULL / ms,
+	       cpu / 1000, cpu / 10 / ms);
+	exit(0);
+}
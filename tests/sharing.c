@@ -20,8 +20,10 @@
 #include <unistd.h>
 #include <string.h>
 #include <plock.h>
+#include <pl-ref.h>
+#include <pl-stats.h>
 
-#define MAXTHREADS	64
+#define MAXTHREADS	128
 
 pthread_t thr[MAXTHREADS];
 int arg_nice;
@@ -34,6 +36,10 @@ static struct timeval start, stop;
 static unsigned long final_work[MAXTHREADS];
 
 unsigned long *locks[MAXTHREADS];
+static struct pl_ref ref;
+static struct pl_ref_slot ref_slots[MAXTHREADS];
+static struct pl_stats stats;
+static unsigned long stats_area[PL_STATS_AREA_LONGS(MAXTHREADS, 1)] __attribute__((aligned(64)));
 
 void oneatwork(void *arg)
 {
@@ -70,6 +76,21 @@ void oneatwork(void *arg)
 			pl_inc(lock);
 		}
 	}
+	else if (arg_am == 3) {
+		while (step == 2) {
+			l++;
+			pl_ref_inc(&ref, thr);
+		}
+	}
+	else if (arg_am == 4) {
+		while (step == 2) {
+			l++;
+			pl_stats_add(&stats, thr, 0, 1);
+			/* fold from time to time */
+			if (!(l & 0xfffff))
+				pl_stats_fold(&stats, thr);
+		}
+	}
 
 	final_work[thr] = l;
 	pl_dec(&actthreads);
@@ -83,6 +104,8 @@ void usage(int ret)
 	       "  0 : (*value)++\n"
 	       "  1 : (volatile *value)++\n"
 	       "  2 : lock_inc(value)\n"
+	       "  3 : pl_ref_inc(value) (distributed, distance is ignored)\n"
+	       "  4 : pl_stats_add(value) (sharded, distance is ignored)\n"
 	       "\n");
 	exit(ret);
 }
@@ -141,6 +164,11 @@ int main(int argc, char **argv)
 			final_work[u] = 0;
 		}
 
+		if (arg_am == 3)
+			pl_ref_init(&ref, ref_slots, nbthreads, 1);
+		else if (arg_am == 4)
+			pl_stats_init(&stats, stats_area, nbthreads, 1, NULL);
+
 		actthreads = 0;	step = 0;
 
 		for (u = 0; u < nbthreads; u++) {
@@ -177,10 +205,27 @@ int main(int argc, char **argv)
 		for (u = 0; u < nbthreads; u++) {
 			total += final_work[u];
 			/* don't count the final value multiple times if it's the same location */
-			if (dist || !u)
+			if (arg_am < 3 && (dist || !u))
 				incr  += *locks[u];
 		}
 
+		if (arg_am == 3) {
+			/* the initial reference is dropped by the kill */
+			pl_ref_kill(&ref);
+			incr = pl_ref_read(&ref);
+			if (incr != total) {
+				printf("bad count %lu, expected %lu!\n", incr, total);
+				exit(1);
+			}
+		}
+		else if (arg_am == 4) {
+			incr = pl_stats_read(&stats, 0);
+			if (incr != total) {
+				printf("bad count %lu, expected %lu!\n", incr, total);
+				exit(1);
+			}
+		}
+
 		printf(" %8lu %8lu (", total/ms, incr/ms);
 		for (u = 0; u < nbthreads; u++)
 			printf("%lu%s", final_work[u]/ms, (u < nbthreads-1) ? " " : "");
@@ -11,6 +11,15 @@
  * allows a more accurate CPU usage measure than vmstat, especially
  * when time is spent in interrupt handling.
  *
+ * By default, reads and writes are simulated using empty loops which never
+ * touch shared data. With "-f", the critical sections instead walk a shared
+ * pointer-chasing ring of cache-line sized nodes of the given footprint (in
+ * kB), so that their duration includes the cost of cache misses and of the
+ * coherence traffic caused by writes. Picking a footprint fitting in L1, L2,
+ * the LLC or only in DRAM gives realistic hold times and their variance. A
+ * simulated read then visits "-d" nodes (16 by default) and a simulated write
+ * modifies 1/20 of this (at least one node).
+ *
  * To compile, you need libpthread :
  *
  *   gcc -I.. -O2 -fomit-frame-pointer -s -o treelock treelock.c -lpthread
@@ -35,6 +44,22 @@ int arg_nice;
 volatile unsigned long actthreads = 0;
 int read_ratio = 256;
 unsigned long global_lock = 0;
+unsigned int arg_footprint = 0; /* kB, 0 = no memory accesses */
+unsigned int arg_depth = 16;    /* nodes visited per simulated read */
+
+/* shared structure walked by the critical sections, one node per cache line */
+struct node {
+	struct node *next;
+	unsigned long val;
+	char pad[0] __attribute__((aligned(64)));
+};
+
+static struct node *nodes;
+static unsigned long nbnodes;
+
+/* per-thread position in the ring and sink for the values read */
+__thread struct node *cursor;
+__thread volatile unsigned long sink;
 
 static volatile unsigned long step;
 
@@ -42,6 +67,88 @@ static struct timeval start, stop;
 static unsigned long global_work;
 static unsigned long final_work;
 
+/* builds a random cyclic permutation of <nbnodes> nodes using Sattolo's
+ * algorithm so that hardware prefetchers cannot guess the next node. Returns
+ * < 0 on allocation failure.
+ */
+static int nodes_init(void)
+{
+	unsigned long *perm;
+	unsigned long i, j, t;
+
+	nbnodes = (unsigned long)arg_footprint * 1024 / sizeof(struct node);
+	if (!nbnodes)
+		nbnodes = 1;
+
+	nodes = aligned_alloc(64, nbnodes * sizeof(struct node));
+	perm = calloc(nbnodes, sizeof(*perm));
+	if (!nodes || !perm)
+		return -1;
+
+	for (i = 0; i < nbnodes; i++)
+		perm[i] = i;
+
+	for (i = nbnodes - 1; i > 0; i--) {
+		j = random() % i;
+		t = perm[i]; perm[i] = perm[j]; perm[j] = t;
+	}
+
+	for (i = 0; i < nbnodes; i++) {
+		nodes[i].next = &nodes[perm[i]];
+		nodes[i].val = i;
+	}
+	free(perm);
+	return 0;
+}
+
+/* simulates reading <n> units of the protected structure, either using an
+ * empty loop or by walking the ring.
+ */
+static inline void cs_read(int n)
+{
+	volatile int i;
+	struct node *node;
+	unsigned long sum = 0;
+
+	if (!arg_footprint) {
+		for (i = 0; i < n; i++);
+		return;
+	}
+
+	node = cursor;
+	for (n = (n * arg_depth + 199) / 200; n > 0; n--) {
+		sum += node->val;
+		node = node->next;
+	}
+	cursor = node;
+	sink = sum;
+}
+
+/* simulates writing <n> units of the protected structure, either using an
+ * empty loop or by modifying nodes of the ring. With <ato> non-zero, the
+ * nodes are updated using atomic operations, as required under the A lock.
+ */
+static inline void cs_write(int n, int ato)
+{
+	volatile int i;
+	struct node *node;
+
+	if (!arg_footprint) {
+		for (i = 0; i < n; i++);
+		return;
+	}
+
+	node = cursor;
+	for (n = (n * arg_depth + 199) / 200; n > 0; n--) {
+		if (ato)
+			pl_add_noret_lax(&node->val, 1);
+		else
+			node->val++;
+		node = node->next;
+	}
+	cursor = node;
+}
+
 /* read: U ; lookup : U ; write : U (reference only, not realistic) */
 void loop_mode0(void)
 {
@@ -51,11 +158,11 @@ void loop_mode0(void)
 	do {
 		if ((loops & 0xFF) < read_ratio) {
 			/* simulate a read */
-			for (i = 0; i < 200; i++);
+			cs_read(200);
 		} else {
 			/* simulate a write */
-			for (i = 0; i < 190; i++);
-			for (i = 0; i < 10; i++);
+			cs_read(190);
+			cs_write(10, 0);
 		}
 		/* simulate some real work */
 		for (i = 0; i < 100; i++);
@@ -74,13 +181,13 @@ void loop_mode1(void)
 		if ((loops & 0xFF) < read_ratio) {
 			/* simulate a read */
 			pl_take_r(&global_lock);
-			for (i = 0; i < 200; i++);
+			cs_read(200);
 			pl_drop_r(&global_lock);
 		} else {
 			/* simulate a write */
 			pl_take_r(&global_lock);
-			for (i = 0; i < 190; i++);
-			for (i = 0; i < 10; i++);
+			cs_read(190);
+			cs_write(10, 1);
 			pl_drop_r(&global_lock);
 		}
 		/* simulate some real work */
@@ -100,14 +207,14 @@ void loop_mode2(void)
 		if ((loops & 0xFF) < read_ratio) {
 			/* simulate a read */
 			pl_take_s(&global_lock);
-			for (i = 0; i < 200; i++);
+			cs_read(200);
 			pl_drop_s(&global_lock);
 		} else {
 			/* simulate a write */
 			pl_take_s(&global_lock);
-			for (i = 0; i < 190; i++);
+			cs_read(190);
 			pl_stow(&global_lock);
-			for (i = 0; i < 10; i++);
+			cs_write(10, 0);
 			pl_drop_w(&global_lock);
 		}
 		/* simulate some real work */
@@ -127,14 +234,14 @@ void loop_mode3(void)
 		if ((loops & 0xFF) < read_ratio) {
 			/* simulate a read */
 			pl_take_r(&global_lock);
-			for (i = 0; i < 200; i++);
+			cs_read(200);
 			pl_drop_r(&global_lock);
 		} else {
 			/* simulate a write */
 			pl_take_s(&global_lock);
-			for (i = 0; i < 190; i++);
+			cs_read(190);
 			pl_stow(&global_lock);
-			for (i = 0; i < 10; i++);
+			cs_write(10, 0);
 			pl_drop_w(&global_lock);
 		}
 		/* simulate some real work */
@@ -154,13 +261,13 @@ void loop_mode4(void)
 		if ((loops & 0xFF) < read_ratio) {
 			/* simulate a read */
 			pl_take_w(&global_lock);
-			for (i = 0; i < 200; i++);
+			cs_read(200);
 			pl_drop_w(&global_lock);
 		} else {
 			/* simulate a write */
 			pl_take_w(&global_lock);
-			for (i = 0; i < 190; i++);
-			for (i = 0; i < 10; i++);
+			cs_read(190);
+			cs_write(10, 0);
 			pl_drop_w(&global_lock);
 		}
 		/* simulate some real work */
@@ -180,13 +287,13 @@ void loop_mode5(void)
 		if ((loops & 0xFF) < read_ratio) {
 			/* simulate a read */
 			pl_take_r(&global_lock);
-			for (i = 0; i < 200; i++);
+			cs_read(200);
 			pl_drop_r(&global_lock);
 		} else {
 			/* simulate a write */
 			pl_take_w(&global_lock);
-			for (i = 0; i < 190; i++);
-			for (i = 0; i < 10; i++);
+			cs_read(190);
+			cs_write(10, 0);
 			pl_drop_w(&global_lock);
 		}
 		/* simulate some real work */
@@ -206,7 +313,7 @@ void loop_mode6(void)
 		if ((loops & 0xFF) < read_ratio) {
 			/* simulate a read */
 			pl_take_r(&global_lock);
-			for (i = 0; i < 200; i++);
+			cs_read(200);
 			pl_drop_r(&global_lock);
 		} else {
 			/* simulate a write */
@@ -215,12 +322,12 @@ void loop_mode6(void)
 				 * the lookup again.
 				 */
 				pl_take_r(&global_lock);
-				for (i = 0; i < 190; i++);
+				cs_read(190);
 				if (pl_try_rtoa(&global_lock))
 					break;
 				pl_drop_r(&global_lock);
 			}
-			for (i = 0; i < 10; i++);
+			cs_write(10, 1);
 			pl_drop_a(&global_lock);
 		}
 		/* simulate some real work */
@@ -240,13 +347,13 @@ void loop_mode7(void)
 		if ((loops & 0xFF) < read_ratio) {
 			/* simulate a read */
 			pl_take_r(&global_lock);
-			for (i = 0; i < 200; i++);
+			cs_read(200);
 			pl_drop_r(&global_lock);
 		} else {
 			/* simulate a write */
 			pl_take_a(&global_lock);
-			for (i = 0; i < 190; i++);
-			for (i = 0; i < 10; i++);
+			cs_read(190);
+			cs_write(10, 1);
 			pl_drop_a(&global_lock);
 		}
 		/* simulate some real work */
@@ -266,7 +373,7 @@ void loop_mode8(void)
 		if ((loops & 0xFF) < read_ratio) {
 			/* simulate a read */
 			pl_take_r(&global_lock);
-			for (i = 0; i < 200; i++);
+			cs_read(200);
 			pl_drop_r(&global_lock);
 		} else {
 			/* simulate a write */
@@ -275,14 +382,14 @@ void loop_mode8(void)
 				 * the lookup again.
 				 */
 				pl_take_r(&global_lock);
-				for (i = 0; i < 190; i++);
+				cs_read(190);
 				if (pl_try_rtos(&global_lock))
 					break;
 				pl_drop_r(&global_lock);
 			}
 			/* now we are S-locked */
 			pl_stow(&global_lock);
-			for (i = 0; i < 10; i++);
+			cs_write(10, 0);
 			pl_drop_w(&global_lock);
 		}
 		/* simulate some real work */
@@ -296,6 +403,10 @@ void oneatwork(int thr)
 {
 	(void)thr; /* to mark it used */
 
+	/* each thread starts at its own place in the ring */
+	if (arg_footprint)
+		cursor = &nodes[random() % nbnodes];
+
 	/* step 0: creating all threads */
 	while (step == 0) {
 		/* don't disturb pthread_create() */
@@ -333,6 +444,7 @@ void oneatwork(int thr)
 void usage(int ret)
 {
 	printf("usage: treelock [-h] [-l] [-n nice] [-t threads] [-r read_ratio(0..256)] [-m <0..8>]\n"
+	       "                [-f footprint_kB] [-d nodes_per_read]\n"
 	       "       modes (-m, default 0) :\n"
 	       "         0 : read: U ; lookup : U ; write : U (reference only, not realistic)\n"
 	       "         1 : read: R ; lookup : R ; write : R (reference only, not realistic)\n"
@@ -343,6 +455,9 @@ void usage(int ret)
 	       "         6 : read: R ; lookup : R ; write : A (typical of atomic pick)\n"
 	       "         7 : read: R ; lookup : A ; write : A (typical of insert+delete)\n"
 	       "         8 : read: R ; lookup : R ; write : W (cache with high hit ratio)\n"
+	       "       -f : walk a shared ring of this size in critical sections (e.g. 16 for L1,\n"
+	       "            256 for L2, 16384 for LLC, 1048576 for DRAM). Default: 0 = empty loops.\n"
+	       "       -d : number of ring nodes visited per read (default 16)\n"
 	       "");
 	exit(ret);
 }
@@ -384,6 +499,16 @@ int main(int argc, char **argv)
 				usage(1);
 			read_ratio = atol(*++argv);
 		}
+		else if (!strcmp(*argv, "-f")) {
+			if (--argc < 0)
+				usage(1);
+			arg_footprint = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-d")) {
+			if (--argc < 0)
+				usage(1);
+			arg_depth = atol(*++argv);
+		}
 		else if (!strcmp(*argv, "-l"))
 			do_lock = 1;
 		else if (!strcmp(*argv, "-h"))
@@ -396,6 +521,11 @@ int main(int argc, char **argv)
 	if (nbthreads >= MAXTHREADS)
 		nbthreads = MAXTHREADS;
 
+	if (arg_footprint && nodes_init() < 0) {
+		perror("nodes_init");
+		exit(1);
+	}
+
 	nice(arg_nice);
 
 	actthreads = 0;	step = 0;
@@ -0,0 +1,462 @@
+/*
+ * Lock states race detection test -- 2026-10-17
+ *
+ * Threads access plain (non-atomic) shared data under the protection of a
+ * plock, going through the various states and transitions, so that a build
+ * with ThreadSanitizer verifies that every access is ordered by the lock:
+ *   - mode 0 (R/W) : readers check the data under R, writers modify it
+ *     under W taken with pl_take_w(), pl_try_w() or pl_try_rtow() ;
+ *   - mode 1 (S)   : seekers read under S, upgrade to W to modify the data,
+ *     then go back to S and to R to read it again, while others read it ;
+ *   - mode 2 (A)   : atomic writers modify their own slot under A, which is
+ *     read by everyone under R or W ;
+ *   - mode 3 (J/C) : readers turn to J or C then A to modify their own slot,
+ *     and the last writer also modifies the shared data ;
+ *   - mode 4 (A->R): thread 0 modifies its slot under A then reads all of
+ *     them after downgrading to R, others read them under R or W. A->R may
+ *     not be mixed with other A users, as it waits for all of them to leave
+ *     while they wait for readers to leave ;
+ *   - mode 5 (LORW): readers and writers of the low overhead R/W locks ;
+ *   - mode 6 (J)   : exclusive J holders modify the shared data, as well as
+ *     W holders, while readers check it. Exclusive J is not mixed with the
+ *     J/C/A group since it only waits for writers to leave before joining,
+ *     and may thus be granted while a member of the group is in A ;
+ *   - mode 7 (futex): pl_take_any_{r,s,w}() with pl_drop_{r,s,w}_wake() ;
+ *   - mode 8 (async): pl_take_{r,s,w}_async() with pl_drop_{r,s,w}_async().
+ *     A queued thread waits for its callback to flag it, which is called by
+ *     the thread granting it the lock.
+ * The data are also checked for consistency, so the test remains meaningful
+ * without the sanitizer. With "-x", mode 0 only uses readers and one of them
+ * deliberately writes under R, which must be reported by ThreadSanitizer. The
+ * lock is a long by default, or an int with "-i" except in modes 5, 7 and 8.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread, and ideally a ThreadSanitizer :
+ *
+ *   gcc -I.. -O1 -g -fsanitize=thread -o tsanlock tsanlock.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <plock.h>
+#include <pl-futex.h>
+#include <pl-async.h>
+
+#define MAXTHREADS 64
+
+/* the waiter bit for modes 7 and 8 */
+#define WBIT 1UL
+
+int arg_mode = 0;
+int arg_threads = 4;
+int arg_int = 0;
+int arg_race = 0;
+unsigned long arg_loops = 20000;
+
+/* <a> and <b> always move together, <slot> are only written by their owner */
+static struct {
+	unsigned long a;
+	unsigned long b;
+} data;
+
+static struct {
+	unsigned long v;
+} __attribute__((aligned(64))) slot[MAXTHREADS];
+
+static unsigned long lock64 __attribute__((aligned(64)));
+static unsigned int  lock32 __attribute__((aligned(64)));
+static struct pl_async_lock alock __attribute__((aligned(64)));
+static struct {
+	struct pl_async_waiter w;
+	unsigned int granted;
+} __attribute__((aligned(64))) waiter[MAXTHREADS];
+static volatile unsigned long step;
+static unsigned long errors[MAXTHREADS];
+
+/* performs operation <op> on the selected lock */
+#define LOCK(op)  do { if (arg_int) op(&lock32); else op(&lock64); } while (0)
+#define TRY(op)   (arg_int ? !!(op(&lock32)) : !!(op(&lock64)))
+
+/* reads the shared data, which must be consistent */
+static void check_data(long thr)
+{
+	if (data.a != data.b)
+		errors[thr]++;
+}
+
+/* modifies the shared data */
+static void write_data(void)
+{
+	data.a++;
+	data.b++;
+}
+
+/* reads all slots, which must not go backwards */
+static void check_slots(long thr, unsigned long *last)
+{
+	int i;
+
+	for (i = 0; i < arg_threads; i++) {
+		if (slot[i].v < last[i])
+			errors[thr]++;
+		last[i] = slot[i].v;
+	}
+}
+
+/* called with the lock held on behalf of a queued thread, possibly by another
+ * thread. The flag is an explicit release, as a scheduler would do.
+ */
+static void granted_cb(struct pl_async_waiter *w)
+{
+	__atomic_store_n((unsigned int *)w->arg, 1, __ATOMIC_RELEASE);
+}
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	unsigned long last[MAXTHREADS] = { 0 };
+	unsigned long *locks[1] = { &lock64 };
+	unsigned long n;
+	int type;
+
+	while (pl_load(&step) == 0)
+		usleep(10000);
+
+	for (n = 0; n < arg_loops; n++) {
+		switch (arg_mode) {
+		case 0: /* R/W */
+			if (arg_race) {
+				/* only readers, so that nothing orders them */
+				LOCK(pl_take_r);
+				check_data(thr);
+				if (thr == 0 && !(n & 255))
+					data.b = data.a; /* wrong ! */
+				LOCK(pl_drop_r);
+				break;
+			}
+
+			switch ((n + thr) % 4) {
+			case 0:
+				LOCK(pl_take_w);
+				write_data();
+				LOCK(pl_drop_w);
+				break;
+			case 1:
+				if (TRY(pl_try_w)) {
+					write_data();
+					LOCK(pl_drop_w);
+				}
+				break;
+			case 2:
+				LOCK(pl_take_r);
+				check_data(thr);
+				if (TRY(pl_try_rtow)) {
+					write_data();
+					LOCK(pl_drop_w);
+				}
+				else
+					LOCK(pl_drop_r);
+				break;
+			default:
+				if (TRY(pl_try_r)) {
+					check_data(thr);
+					LOCK(pl_drop_r);
+				}
+				break;
+			}
+			break;
+
+		case 1: /* S */
+			switch ((n + thr) % 4) {
+			case 0:
+				LOCK(pl_take_s);
+				check_data(thr);
+				LOCK(pl_stow);
+				write_data();
+				LOCK(pl_wtos);
+				check_data(thr);
+				LOCK(pl_stor);
+				check_data(thr);
+				LOCK(pl_drop_r);
+				break;
+			case 1:
+				if (TRY(pl_try_s)) {
+					check_data(thr);
+					LOCK(pl_stow);
+					write_data();
+					LOCK(pl_wtor);
+					check_data(thr);
+					LOCK(pl_drop_r);
+				}
+				break;
+			case 2:
+				LOCK(pl_take_r);
+				check_data(thr);
+				if (TRY(pl_try_rtos)) {
+					LOCK(pl_stow);
+					write_data();
+					LOCK(pl_wtos);
+					LOCK(pl_drop_s);
+				}
+				else
+					LOCK(pl_drop_r);
+				break;
+			default:
+				LOCK(pl_take_r);
+				check_data(thr);
+				LOCK(pl_drop_r);
+				break;
+			}
+			break;
+
+		case 2: /* A */
+			switch ((n + thr) % 4) {
+			case 0:
+				LOCK(pl_take_a);
+				slot[thr].v++;
+				LOCK(pl_drop_a);
+				break;
+			case 1:
+				if (TRY(pl_try_a)) {
+					slot[thr].v++;
+					LOCK(pl_drop_a);
+				}
+				break;
+			case 2:
+				LOCK(pl_take_r);
+				check_slots(thr, last);
+				if (TRY(pl_try_rtoa)) {
+					slot[thr].v++;
+					LOCK(pl_drop_a);
+				}
+				else
+					LOCK(pl_drop_r);
+				break;
+			default:
+				LOCK(pl_take_w);
+				check_slots(thr, last);
+				LOCK(pl_drop_w);
+				break;
+			}
+			break;
+
+		case 3: /* J/C */
+			switch ((n + thr) % 4) {
+			case 0:
+			case 1:
+				LOCK(pl_take_r);
+				check_data(thr);
+				check_slots(thr, last);
+				if ((n + thr) % 4 == 0) {
+					LOCK(pl_rtoj);
+					LOCK(pl_jtoc);
+				}
+				else
+					LOCK(pl_rtoc);
+				LOCK(pl_ctoa);
+				slot[thr].v++;
+				if (TRY(pl_last_writer))
+					write_data();
+				LOCK(pl_drop_a);
+				break;
+			default:
+				LOCK(pl_take_r);
+				check_data(thr);
+				check_slots(thr, last);
+				LOCK(pl_drop_r);
+				break;
+			}
+			break;
+
+		case 4: /* A->R, see above */
+			if (thr == 0) {
+				LOCK(pl_take_a);
+				slot[thr].v++;
+				LOCK(pl_ator);
+				check_slots(thr, last);
+				LOCK(pl_drop_r);
+			}
+			else if (n & 1) {
+				LOCK(pl_take_r);
+				check_slots(thr, last);
+				LOCK(pl_drop_r);
+			}
+			else {
+				LOCK(pl_take_w);
+				check_slots(thr, last);
+				LOCK(pl_drop_w);
+			}
+			break;
+
+		case 5: /* LORW */
+			if ((n + thr) % 4 == 0) {
+				pl_lorw_wrlock(&lock64);
+				write_data();
+				pl_lorw_unlock(&lock64);
+			}
+			else {
+				pl_lorw_rdlock(&lock64);
+				check_data(thr);
+				pl_lorw_rdunlock(&lock64);
+			}
+			break;
+
+		case 6: /* exclusive J */
+			switch ((n + thr) % 4) {
+			case 0:
+				LOCK(pl_take_j);
+				write_data();
+				LOCK(pl_drop_j);
+				break;
+			case 1:
+				if (TRY(pl_try_j)) {
+					write_data();
+					LOCK(pl_drop_j);
+				}
+				break;
+			case 2:
+				LOCK(pl_take_w);
+				write_data();
+				LOCK(pl_drop_w);
+				break;
+			default:
+				LOCK(pl_take_r);
+				check_data(thr);
+				LOCK(pl_drop_r);
+				break;
+			}
+			break;
+
+		case 7: /* futex */
+			switch ((n + thr) % 4) {
+			case 0:
+				pl_take_any_w(locks, 1, WBIT);
+				write_data();
+				pl_drop_w_wake(&lock64, WBIT);
+				break;
+			case 1:
+				pl_take_any_s(locks, 1, WBIT);
+				check_data(thr);
+				pl_drop_s_wake(&lock64, WBIT);
+				break;
+			default:
+				pl_take_any_r(locks, 1, WBIT);
+				check_data(thr);
+				pl_drop_r_wake(&lock64, WBIT);
+				break;
+			}
+			break;
+
+		case 8: /* async */
+			type = ((n + thr) % 4 == 0) ? PL_TAKE_W : ((n + thr) % 4 == 1) ? PL_TAKE_S : PL_TAKE_R;
+			if (!pl_take_async(&alock, type, &waiter[thr].w, granted_cb, &waiter[thr].granted)) {
+				while (!__atomic_load_n(&waiter[thr].granted, __ATOMIC_ACQUIRE))
+					pl_cpu_relax();
+				waiter[thr].granted = 0;
+			}
+
+			if (type == PL_TAKE_W) {
+				write_data();
+				pl_drop_w_async(&alock, NULL);
+			}
+			else if (type == PL_TAKE_S) {
+				check_data(thr);
+				pl_drop_s_async(&alock, NULL);
+			}
+			else {
+				check_data(thr);
+				pl_drop_r_async(&alock, NULL);
+			}
+			break;
+		}
+	}
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: tsanlock [-h] [-m mode] [-t threads] [-l loops] [-i] [-x]\n"
+	       "Modes :\n"
+	       "  0 : R and W\n"
+	       "  1 : S and its transitions to W and R\n"
+	       "  2 : A and R->A, with R and W\n"
+	       "  3 : R->J->C->A and R->C->A\n"
+	       "  4 : A->R by thread 0, R and W by other threads\n"
+	       "  5 : LORW read and write locks\n"
+	       "  6 : exclusive J, with R and W\n"
+	       "  7 : pl_take_any_{r,s,w}() and pl_drop_{r,s,w}_wake()\n"
+	       "  8 : pl_take_{r,s,w}_async() and pl_drop_{r,s,w}_async()\n"
+	       "  -i : use a 32-bit lock instead of a long\n"
+	       "  -x : deliberately write under R (mode 0) to verify that races are reported\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long errs;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			arg_threads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-i"))
+			arg_int = 1;
+		else if (!strcmp(*argv, "-x"))
+			arg_race = 1;
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 8 || !arg_loops ||
+	    arg_threads < 1 || arg_threads > MAXTHREADS ||
+	    (arg_mode >= 5 && arg_mode != 6 && arg_int))
+		usage(1);
+
+	for (i = 0; i < arg_threads; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_threads; i++)
+		pthread_join(thr[i], NULL);
+
+	for (i = errs = 0; i < arg_threads; i++)
+		errs += errors[i];
+
+	if (errs || data.a != data.b) {
+		fprintf(stderr, "Bad result: %lu inconsistencies, a=%lu b=%lu!\n", errs, data.a, data.b);
+		exit(1);
+	}
+
+	printf("mode: %d threads: %d lock: %d bits loops: %lu writes: %lu\n",
+	       arg_mode, arg_threads, arg_int ? 32 : 64, arg_loops, data.a);
+	exit(0);
+}
@@ -0,0 +1,375 @@
+/*
+ * io_uring lock waits tester -- 2026-10-17
+ *
+ * Each thread runs an event loop around its own io_uring, and processes a
+ * number of concurrent tasks. Each task takes the W lock on a random shard,
+ * works for a while under the lock, releases it, then performs a fake I/O
+ * (a NOP request) and starts over once it completes. In mode 0 the lock is
+ * taken using pl_take_w(), which spins when the lock is held. In mode 1 it
+ * is taken with pl_uring_take_w(), and when the lock is held, the task is
+ * parked on an IORING_OP_FUTEX_WAIT request (Linux 6.7+) while the loop keeps
+ * processing other tasks' events, and the release is performed using
+ * pl_uring_drop_w() followed by an IORING_OP_FUTEX_WAKE request when needed.
+ * The ring is driven with raw syscalls so that liburing is not needed.
+ *
+ * You can do whatever you want with this program, but I'm not
+ * responsible for any misuse.
+ *
+ * To compile, you need libpthread :
+ *
+ *   gcc -I.. -O2 -fomit-frame-pointer -s -o uringlock uringlock.c -lpthread
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pl-uring.h>
+
+#define MAXTHREADS 64
+#define MAXTASKS   256
+#define MAXSHARDS  1024
+
+/* waiter bit, one of the application bits */
+#define WBIT 1UL
+
+/* user_data encoding : task number and event type */
+#define EV_IO    0x000000ULL
+#define EV_PARK  0x100000ULL
+#define EV_WAKE  0x200000ULL
+#define EV_MASK  0xF00000ULL
+
+struct shard {
+	unsigned long lock;
+	unsigned long count;
+	char pad[64 - 2 * sizeof(long)];
+} __attribute__((aligned(64)));
+
+/* minimal io_uring, only what the event loop needs */
+struct ring {
+	int fd;
+	unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	unsigned int sq_entries;
+	unsigned int tail;    /* local SQ tail */
+	unsigned int pending; /* SQEs not submitted yet */
+};
+
+int arg_mode = 0;
+int arg_threads = 4;
+int arg_shards = 8;
+int arg_tasks = 16;
+unsigned long arg_loops = 100000;
+unsigned int arg_work = 100;
+
+static struct shard shards[MAXSHARDS];
+static volatile unsigned long step;
+static unsigned long cpu_ns[MAXTHREADS];
+static unsigned long parks[MAXTHREADS];
+static struct timeval start, stop;
+
+static unsigned int rnd32seed = 2463534242U;
+
+static inline unsigned int rnd32(unsigned int *seed)
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return *seed;
+}
+
+static int ring_init(struct ring *r, unsigned int entries)
+{
+	struct io_uring_params p;
+	size_t sq_sz, cq_sz;
+	void *sq, *cq;
+
+	memset(&p, 0, sizeof(p));
+	r->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (r->fd < 0)
+		return -1;
+
+	sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (cq_sz > sq_sz)
+			sq_sz = cq_sz;
+		cq_sz = sq_sz;
+	}
+
+	sq = mmap(NULL, sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED)
+		return -1;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		cq = sq;
+	else {
+		cq = mmap(NULL, cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+		if (cq == MAP_FAILED)
+			return -1;
+	}
+
+	r->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+	               MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED)
+		return -1;
+
+	r->sq_head  = sq + p.sq_off.head;
+	r->sq_tail  = sq + p.sq_off.tail;
+	r->sq_mask  = sq + p.sq_off.ring_mask;
+	r->sq_array = sq + p.sq_off.array;
+	r->cq_head  = cq + p.cq_off.head;
+	r->cq_tail  = cq + p.cq_off.tail;
+	r->cq_mask  = cq + p.cq_off.ring_mask;
+	r->cqes     = cq + p.cq_off.cqes;
+	r->sq_entries = p.sq_entries;
+	r->tail = *r->sq_tail;
+	r->pending = 0;
+	return 0;
+}
+
+/* submits pending SQEs and waits for at least <wait> completions */
+static int ring_enter(struct ring *r, unsigned int wait)
+{
+	int ret;
+
+	__atomic_store_n(r->sq_tail, r->tail, __ATOMIC_RELEASE);
+	ret = syscall(__NR_io_uring_enter, r->fd, r->pending, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	if (ret >= 0)
+		r->pending -= ret;
+	return ret;
+}
+
+/* returns a new SQE, submitting the pending ones first if the ring is full */
+static struct io_uring_sqe *ring_get_sqe(struct ring *r)
+{
+	unsigned int idx;
+
+	while (r->tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->sq_entries) {
+		if (ring_enter(r, 0) < 0) {
+			perror("io_uring_enter");
+			exit(1);
+		}
+	}
+	idx = r->tail & *r->sq_mask;
+	r->sq_array[idx] = idx;
+	r->tail++;
+	r->pending++;
+	return &r->sqes[idx];
+}
+
+/* runs one step of task <t> on lock <lock>. Returns 1 if the task was
+ * parked, otherwise 0 after having submitted its fake I/O.
+ */
+static int run_task(struct ring *r, int t, struct shard *sh)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int val, w;
+
+	if (arg_mode == 0)
+		pl_take_w(&sh->lock);
+	else if (!pl_uring_take_w(&sh->lock, WBIT, &val)) {
+		pl_uring_prep_wait(ring_get_sqe(r), &sh->lock, WBIT, val, EV_PARK | t);
+		return 1;
+	}
+
+	sh->count++;
+	for (w = 0; w < arg_work; w++)
+		pl_cpu_relax();
+
+	if (arg_mode == 0)
+		pl_drop_w(&sh->lock);
+	else if (pl_uring_drop_w(&sh->lock, WBIT))
+		pl_uring_prep_wake(ring_get_sqe(r), &sh->lock, WBIT, EV_WAKE | t);
+
+	sqe = ring_get_sqe(r);
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_NOP;
+	sqe->user_data = EV_IO | t;
+	return 0;
+}
+
+void *oneatwork(void *arg)
+{
+	long thr = (long)arg;
+	struct shard *task_shard[MAXTASKS];
+	unsigned long started, inflight;
+	unsigned int seed = rnd32seed + thr;
+	struct io_uring_cqe *cqe;
+	struct timespec ts;
+	struct ring r;
+	unsigned int head;
+	int t;
+
+	if (ring_init(&r, 4 * MAXTASKS) < 0) {
+		perror("io_uring_setup");
+		exit(1);
+	}
+
+	while (step == 0)
+		usleep(10000);
+
+	/* start all tasks */
+	started = inflight = 0;
+	for (t = 0; t < arg_tasks && started < arg_loops; t++) {
+		task_shard[t] = &shards[rnd32(&seed) % arg_shards];
+		parks[thr] += run_task(&r, t, task_shard[t]);
+		started++;
+		inflight++;
+	}
+
+	while (inflight) {
+		if (ring_enter(&r, 1) < 0) {
+			perror("io_uring_enter");
+			exit(1);
+		}
+
+		head = *r.cq_head;
+		while (head != __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE)) {
+			cqe = &r.cqes[head & *r.cq_mask];
+			t = cqe->user_data & ~EV_MASK;
+
+			switch (cqe->user_data & EV_MASK) {
+			case EV_IO:
+				/* fake I/O done, start over on another shard */
+				inflight--;
+				if (started < arg_loops) {
+					task_shard[t] = &shards[rnd32(&seed) % arg_shards];
+					parks[thr] += run_task(&r, t, task_shard[t]);
+					started++;
+					inflight++;
+				}
+				break;
+			case EV_PARK:
+				/* woken up (0) or the value changed (-EAGAIN) */
+				if (cqe->res < 0 && cqe->res != -EAGAIN) {
+					fprintf(stderr, "FUTEX_WAIT failed: %s\n", strerror(-cqe->res));
+					exit(1);
+				}
+				parks[thr] += run_task(&r, t, task_shard[t]);
+				break;
+			case EV_WAKE:
+				if (cqe->res < 0) {
+					fprintf(stderr, "FUTEX_WAKE failed: %s\n", strerror(-cqe->res));
+					exit(1);
+				}
+				break;
+			}
+			head++;
+		}
+		__atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	cpu_ns[thr] = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	return NULL;
+}
+
+void usage(int ret)
+{
+	printf("usage: uringlock [-h] [-m mode] [-t threads] [-s shards] [-c tasks] [-l loops] [-w work]\n"
+	       "Modes :\n"
+	       "  0 : spin using pl_take_w()\n"
+	       "  1 : park on IORING_OP_FUTEX_WAIT using pl_uring_take_w()\n"
+	       "\n");
+	exit(ret);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t thr[MAXTHREADS];
+	unsigned long ms, total, cpu, parked;
+	long i;
+
+	argc--; argv++;
+	while (argc > 0) {
+		if (!strcmp(*argv, "-m")) {
+			if (--argc < 0)
+				usage(1);
+			arg_mode = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-t")) {
+			if (--argc < 0)
+				usage(1);
+			arg_threads = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-s")) {
+			if (--argc < 0)
+				usage(1);
+			arg_shards = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-c")) {
+			if (--argc < 0)
+				usage(1);
+			arg_tasks = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-l")) {
+			if (--argc < 0)
+				usage(1);
+			arg_loops = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-w")) {
+			if (--argc < 0)
+				usage(1);
+			arg_work = atol(*++argv);
+		}
+		else if (!strcmp(*argv, "-h"))
+			usage(0);
+		else
+			usage(1);
+		argc--; argv++;
+	}
+
+	if (arg_mode < 0 || arg_mode > 1 || !arg_loops ||
+	    arg_threads < 1 || arg_threads > MAXTHREADS ||
+	    arg_shards < 1 || arg_shards > MAXSHARDS ||
+	    arg_tasks < 1 || arg_tasks > MAXTASKS)
+		usage(1);
+
+	for (i = 0; i < arg_threads; i++) {
+		if (pthread_create(&thr[i], NULL, oneatwork, (void *)i) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	pl_inc_noret(&step);
+
+	for (i = 0; i < arg_threads; i++)
+		pthread_join(thr[i], NULL);
+	gettimeofday(&stop, NULL);
+
+	ms = (stop.tv_sec - start.tv_sec) * 1000 + ((long)stop.tv_usec - (long)start.tv_usec) / 1000;
+	if (!ms)
+		ms = 1;
+
+	for (i = total = 0; i < arg_shards; i++) {
+		if (shards[i].lock & ~WBIT) {
+			fprintf(stderr, "Shard %ld left locked: %#lx!\n", i, shards[i].lock);
+			exit(1);
+		}
+		total += shards[i].count;
+	}
+
+	if (total != arg_threads * arg_loops) {
+		fprintf(stderr, "Bad total count %lu, expected %lu!\n", total, arg_threads * arg_loops);
+		exit(1);
+	}
+
+	for (i = cpu = parked = 0; i < arg_threads; i++) {
+		cpu += cpu_ns[i] / 1000;
+		parked += parks[i];
+	}
+
+	printf("mode: %d threads: %d shards: %d loops: %lu parked: %lu time(ms): %lu rate(lps): %Lu, cpu(ms): %lu (%lu%%)\n",
+	       arg_mode, arg_threads, arg_shards, total, parked, ms, total * 1000ULL / ms,
+	       cpu / 1000, cpu / 10 / ms);
+	exit(0);
+}